@@ -0,0 +1,143 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// vim: set noet:
+
+/** @file */
+
+#include "clane_ascii.hpp"
+
+#if defined __SSE2__
+#include <emmintrin.h>
+#define CLANE_ASCII_SSE2
+#endif
+
+// AVX2 code is compiled per function and used only if the CPU supports it.
+// GCC supports intrinsics in such functions starting with version 4.9.
+#if (defined __x86_64__ || defined __i386__) && \
+	(defined __clang__ || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define CLANE_ASCII_AVX2
+#endif
+
+namespace clane {
+	namespace ascii {
+
+		static bool is_control_char(char c) {
+			return (0 <= c && c < 32 && c != '\t') || c == 127;
+		}
+
+		static char const *find_control_char_scalar(char const *beg, char const *end) {
+			return std::find_if(beg, end, is_control_char);
+		}
+
+#ifdef CLANE_ASCII_SSE2
+		static char const *find_control_char_sse2(char const *beg, char const *end) {
+			__m128i const minus_one = _mm_set1_epi8(-1);
+			__m128i const space = _mm_set1_epi8(' ');
+			__m128i const tab = _mm_set1_epi8('\t');
+			__m128i const del = _mm_set1_epi8(127);
+			char const *p = beg;
+			for (; end - p >= 16; p += 16) {
+				__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+				__m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(v, minus_one), _mm_cmplt_epi8(v, space));
+				ctl = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab), ctl);
+				ctl = _mm_or_si128(ctl, _mm_cmpeq_epi8(v, del));
+				int const mask = _mm_movemask_epi8(ctl);
+				if (mask)
+					return p + __builtin_ctz(mask);
+			}
+			return find_control_char_scalar(p, end);
+		}
+#endif
+
+#ifdef CLANE_ASCII_AVX2
+		__attribute__((target("avx2")))
+		static char const *find_control_char_avx2(char const *beg, char const *end) {
+			__m256i const minus_one = _mm256_set1_epi8(-1);
+			__m256i const space = _mm256_set1_epi8(' ');
+			__m256i const tab = _mm256_set1_epi8('\t');
+			__m256i const del = _mm256_set1_epi8(127);
+			char const *p = beg;
+			for (; end - p >= 32; p += 32) {
+				__m256i const v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+				__m256i ctl = _mm256_and_si256(_mm256_cmpgt_epi8(v, minus_one), _mm256_cmpgt_epi8(space, v));
+				ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), ctl);
+				ctl = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, del));
+				unsigned const mask = _mm256_movemask_epi8(ctl);
+				if (mask)
+					return p + __builtin_ctz(mask);
+			}
+			return find_control_char_scalar(p, end);
+		}
+#endif
+
+		static bool is_simd_supported(simd_level level) {
+			switch (level) {
+				case simd_level::none:
+					return true;
+				case simd_level::sse2:
+#ifdef CLANE_ASCII_SSE2
+					return true;
+#else
+					return false;
+#endif
+				case simd_level::avx2:
+#ifdef CLANE_ASCII_AVX2
+					__builtin_cpu_init();
+					return __builtin_cpu_supports("avx2");
+#else
+					return false;
+#endif
+			}
+			return false;
+		}
+
+		static simd_level best_simd() {
+			if (is_simd_supported(simd_level::avx2))
+				return simd_level::avx2;
+			if (is_simd_supported(simd_level::sse2))
+				return simd_level::sse2;
+			return simd_level::none;
+		}
+
+		static char const *(*find_control_char_impl(simd_level level))(char const *, char const *) {
+			switch (level) {
+#ifdef CLANE_ASCII_AVX2
+				case simd_level::avx2:
+					return find_control_char_avx2;
+#endif
+#ifdef CLANE_ASCII_SSE2
+				case simd_level::sse2:
+					return find_control_char_sse2;
+#endif
+				default:
+					return find_control_char_scalar;
+			}
+		}
+
+		// The instruction set is chosen once, at startup.
+		static simd_level cur_simd = best_simd();
+		static char const *(*cur_find_control_char)(char const *, char const *) = find_control_char_impl(cur_simd);
+
+		char const *find_control_char(char const *beg, char const *end) {
+			assert(beg <= end);
+			return cur_find_control_char(beg, end);
+		}
+
+		simd_level simd() {
+			return cur_simd;
+		}
+
+		bool set_simd(simd_level level) {
+			if (!is_simd_supported(level))
+				return false;
+			cur_simd = level;
+			cur_find_control_char = find_control_char_impl(level);
+			return true;
+		}
+
+	}
+}
+
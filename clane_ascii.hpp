@@ -13,12 +13,50 @@
 #include "include/clane_ascii_pub.hpp"
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <limits>
 #include <string>
+#include <type_traits>
 
 namespace clane {
 
 	namespace ascii {
 
+		/** @brief Returns a pointer to the first occurrence of a character in a
+		 * memory block, or else `end`
+		 *
+		 * @remark This uses memchr(), which the C library implements with
+		 * vector instructions chosen for the CPU at run time. */
+		inline char const *find_char(char const *beg, char const *end, char c) {
+			assert(beg <= end);
+			void const *p = std::memchr(beg, c, end - beg);
+			return p ? static_cast<char const *>(p) : end;
+		}
+
+		/** @brief Returns a pointer to the first control character other than
+		 * horizontal tab in a memory block, or else `end`
+		 *
+		 * @remark Bytes outside the ASCII range aren't control characters. */
+		char const *find_control_char(char const *beg, char const *end);
+
+		/** @brief Instruction set used by find_control_char() */
+		enum class simd_level {
+			none,
+			sse2,
+			avx2
+		};
+
+		/** @brief Returns the instruction set used by find_control_char()
+		 *
+		 * @remark By default, this is the best level the CPU supports. */
+		simd_level simd();
+
+		/** @brief Sets the instruction set used by find_control_char(), returning
+		 * false if the CPU doesn't support it
+		 *
+		 * @remark This is for testing and benchmarking and isn't thread-safe. */
+		bool set_simd(simd_level level);
+
 		/** @brief Search a string for a newline
 		 *
 		 * @remark The find_newline() function searches a given memory block for the
@@ -36,7 +74,7 @@ namespace clane {
 		 * followed by a character other than a newline is considered readable. */
 		inline char const *find_newline(char const *beg, char const *end) {
 			assert(beg <= end);
-			char const *newline = std::find(beg, end, '\n');
+			char const *newline = find_char(beg, end, '\n');
 			if (newline > beg && *(newline-1) == '\r')
 				return newline - 1; // carriage return before newline
 			if (newline != end)
@@ -51,6 +89,14 @@ namespace clane {
 			s.erase(std::find_if_not(s.rbegin(), s.rend(), isspace).base(), s.end());
 		}
 
+		/** @brief Returns the end of a memory block after excluding any
+		 * whitespace at its end */
+		inline char const *rtrim(char const *beg, char const *end) {
+			while (end > beg && std::isspace(*(end-1)))
+				--end;
+			return end;
+		}
+
 		inline char const *skip_whitespace(char const *beg, char const *end) {
 			char const *p = beg;
 			while (p < end && std::isspace(*p)) {
@@ -79,6 +125,37 @@ namespace clane {
 			return 'A' + (n - 10);
 		}
 
+		/** @brief Appends a digit to an unsigned integer in a given base
+		 *
+		 * @remark The append_digit() function returns false, leaving the integer
+		 * unchanged, if the result would overflow. */
+		template <typename Unsigned> bool append_digit(Unsigned &n, unsigned base, unsigned digit) {
+			static_assert(std::is_unsigned<Unsigned>::value, "append_digit() requires an unsigned type");
+			assert(digit < base);
+			if (n > (std::numeric_limits<Unsigned>::max() - digit) / base)
+				return false;
+			n = n * base + digit;
+			return true;
+		}
+
+		/** @brief Parses a decimal integer comprising only digits--no sign or
+		 * whitespace
+		 *
+		 * @remark The parse_decimal() function returns false, leaving the output
+		 * unchanged, if the string is empty, has a non-digit character, or
+		 * overflows. It doesn't depend on the locale. */
+		template <typename Unsigned> bool parse_decimal(char const *beg, char const *end, Unsigned &out) {
+			if (beg == end)
+				return false;
+			Unsigned n = 0;
+			for (char const *p = beg; p < end; ++p) {
+				if (*p < '0' || '9' < *p || !append_digit(n, 10, *p - '0'))
+					return false;
+			}
+			out = n;
+			return true;
+		}
+
 	}
 }
 
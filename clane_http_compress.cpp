@@ -0,0 +1,275 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// vim: set noet:
+
+/** @file */
+
+#include "clane_http_message.hpp"
+#include "clane_http_server.hpp"
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <system_error>
+#include <zlib.h>
+
+namespace clane {
+	namespace http {
+
+		struct deflate_streambuf::deflater {
+			z_stream zs;
+			bool zs_init;
+			int window_bits;
+			int level;
+			char in[8 * 1024]; // put area
+			char out[8 * 1024];
+			deflater(): zs{}, zs_init{}, window_bits{}, level{} {}
+			~deflater() {
+				if (zs_init)
+					::deflateEnd(&zs);
+			}
+		};
+
+		// Each thread keeps one deflater for reuse, so that compressing a response
+		// needn't allocate zlib state or buffers. (The thread-specific pointer
+		// is a pthread key rather than thread_local, which GCC < 4.8 lacks.)
+		static pthread_key_t spare_key;
+		static std::once_flag spare_key_once;
+
+		static void delete_deflater(void *p) {
+			delete static_cast<deflate_streambuf::deflater *>(p);
+		}
+
+		static void init_spare_key() {
+			if (::pthread_key_create(&spare_key, delete_deflater))
+				throw std::system_error(errno, std::system_category(), "pthread_key_create");
+		}
+
+		static std::unique_ptr<deflate_streambuf::deflater> take_spare_deflater() {
+			std::call_once(spare_key_once, init_spare_key);
+			std::unique_ptr<deflate_streambuf::deflater> z(static_cast<deflate_streambuf::deflater *>(
+				::pthread_getspecific(spare_key)));
+			::pthread_setspecific(spare_key, nullptr);
+			return z;
+		}
+
+		static void give_spare_deflater(std::unique_ptr<deflate_streambuf::deflater> &&z) {
+			std::call_once(spare_key_once, init_spare_key);
+			if (!::pthread_getspecific(spare_key) && !::pthread_setspecific(spare_key, z.get()))
+				z.release();
+		}
+
+		// Returns true if a content type is worth compressing.
+		static bool is_compressible_type(std::string const &type) {
+			std::string t = type.substr(0, type.find(';'));
+			ascii::rtrim(t);
+			for (auto i = t.begin(); i != t.end(); ++i)
+				*i = std::tolower(*i);
+			static char const *const types[] = {
+				"application/javascript",
+				"application/json",
+				"application/x-javascript",
+				"application/xml",
+				"image/svg+xml",
+			};
+			for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+				if (t == types[i])
+					return true;
+			}
+			return !t.compare(0, 5, "text/") ||
+				(t.size() > 5 && (!t.compare(t.size() - 5, 5, "+json") || !t.compare(t.size() - 4, 4, "+xml")));
+		}
+
+		deflate_streambuf::~deflate_streambuf() {
+			release();
+		}
+
+		deflate_streambuf::deflate_streambuf(server_streambuf &down): down(down), coding{coding_type::none},
+			state{state_type::disabled}, level{}, min_size{} {}
+
+		void deflate_streambuf::enable(header_map const &req_hdrs, int level, size_t min_size) {
+			coding = coding_type::none;
+			auto ae = req_hdrs.find(header_id::accept_encoding);
+			if (ae != req_hdrs.end()) {
+				float const gzip_q = accept_encoding_quality(ae->second, "gzip");
+				float const deflate_q = accept_encoding_quality(ae->second, "deflate");
+				if (gzip_q > 0.0f && gzip_q >= deflate_q)
+					coding = coding_type::gzip;
+				else if (deflate_q > 0.0f)
+					coding = coding_type::deflate;
+			}
+			this->level = level;
+			this->min_size = min_size;
+			state = state_type::undecided;
+		}
+
+		server_streambuf *deflate_streambuf::bypass() {
+			if (state_type::disabled == state || state_type::passing == state)
+				return &down;
+			if (state_type::compressing == state || pptr() != pbase())
+				return nullptr; // too late
+			state = state_type::passing;
+			release();
+			return &down;
+		}
+
+		void deflate_streambuf::finish() {
+			if (state_type::disabled == state)
+				return;
+			if (state_type::undecided == state && z)
+				decide(true);
+			write_out(Z_FINISH); // any error surfaces in server_streambuf
+			release();
+			state = state_type::disabled;
+		}
+
+		int deflate_streambuf::sync() {
+			if (state_type::undecided == state)
+				decide(false);
+			if (!write_out(Z_SYNC_FLUSH))
+				return -1;
+			return down.pubsync();
+		}
+
+		deflate_streambuf::int_type deflate_streambuf::overflow(int_type ch) {
+			// On the first output, set up the put area.
+			if (!z && state_type::undecided == state && !acquire())
+				state = state_type::passing;
+			if (!z) {
+				if (traits_type::eq_int_type(ch, traits_type::eof()))
+					return traits_type::not_eof(ch);
+				return down.sputc(traits_type::to_char_type(ch));
+			}
+			if (pptr() == epptr()) {
+				if (state_type::undecided == state)
+					decide(false);
+				if (!write_out(Z_NO_FLUSH))
+					return traits_type::eof();
+			}
+			if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+				*pptr() = traits_type::to_char_type(ch);
+				pbump(1);
+			}
+			return traits_type::not_eof(ch);
+		}
+
+		std::streamsize deflate_streambuf::xsputn(char const *s, std::streamsize n) {
+			// Without a put area, e.g., once bypassed, pass each block through
+			// whole rather than a character at a time via overflow().
+			if (!z && state_type::undecided != state)
+				return down.sputn(s, n);
+			return std::streambuf::xsputn(s, n);
+		}
+
+		bool deflate_streambuf::acquire() {
+			z = take_spare_deflater();
+			if (!z)
+				z.reset(new (std::nothrow) deflater);
+			if (!z)
+				return false;
+			setp(z->in, z->in + sizeof(z->in));
+			return true;
+		}
+
+		void deflate_streambuf::release() {
+			setp(nullptr, nullptr);
+			if (!z)
+				return;
+			if (z->zs_init && Z_OK != ::deflateReset(&z->zs)) {
+				z.reset();
+				return;
+			}
+			give_spare_deflater(std::move(z));
+			z.reset();
+		}
+
+		void deflate_streambuf::decide(bool end) {
+			state = state_type::passing;
+			header_map &hdrs = down.out_hdrs;
+			int const stat = static_cast<int>(down.out_stat_code);
+			if (stat < 200 || 204 == stat || 206 == stat || 304 == stat || hdrs.count(header_id::content_encoding))
+				return;
+			auto type = hdrs.find(header_id::content_type);
+			if (type == hdrs.end() || !is_compressible_type(type->second))
+				return;
+
+			// The body's encoding depends on Accept-Encoding whether or not this
+			// response is compressed.
+			bool has_vary = false;
+			auto vary = hdrs.equal_range(header_id::vary);
+			for (auto i = vary.first; i != vary.second; ++i) {
+				std::string v = i->second;
+				for (auto j = v.begin(); j != v.end(); ++j)
+					*j = std::tolower(*j);
+				if (std::string::npos != v.find("accept-encoding") || std::string::npos != v.find('*'))
+					has_vary = true;
+			}
+			if (!has_vary)
+				hdrs.insert(header("vary", "accept-encoding"));
+
+			if (coding_type::none == coding || (end && static_cast<size_t>(pptr() - pbase()) < min_size))
+				return;
+			if (!z && !acquire())
+				return;
+
+			// Set up zlib, reusing the thread's state where possible. A gzip stream
+			// and a raw zlib stream differ in window bits, which only
+			// reinitialization can change.
+			int const window_bits = coding_type::gzip == coding ? 15 + 16 : 15;
+			if (z->zs_init && z->window_bits != window_bits) {
+				::deflateEnd(&z->zs);
+				z->zs_init = false;
+			}
+			if (!z->zs_init) {
+				z->zs = z_stream{};
+				if (Z_OK != ::deflateInit2(&z->zs, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY))
+					return;
+				z->zs_init = true;
+				z->window_bits = window_bits;
+				z->level = level;
+			} else if (z->level != level) {
+				if (Z_OK != ::deflateParams(&z->zs, level, Z_DEFAULT_STRATEGY))
+					return;
+				z->level = level;
+			}
+
+			hdrs.erase(header_id::content_length);
+			hdrs.insert(header("content-encoding", coding_type::gzip == coding ? "gzip" : "deflate"));
+			// The compressed body is a different representation, so a strong
+			// entity tag would be wrong.
+			auto etag = hdrs.find(header_id::etag);
+			if (etag != hdrs.end() && etag->second.compare(0, 2, "W/"))
+				etag->second = "W/" + etag->second;
+			state = state_type::compressing;
+		}
+
+		bool deflate_streambuf::write_out(int flush) {
+			char *const beg = pbase();
+			size_t const size = pptr() - pbase();
+			if (beg)
+				setp(beg, epptr());
+			if (state_type::passing == state)
+				return !size || static_cast<std::streamsize>(size) == down.sputn(beg, size);
+			if (state_type::compressing != state)
+				return true;
+			z_stream &zs = z->zs;
+			zs.next_in = reinterpret_cast<Bytef *>(beg);
+			zs.avail_in = size;
+			while (true) {
+				zs.next_out = reinterpret_cast<Bytef *>(z->out);
+				zs.avail_out = sizeof(z->out);
+				int const zstat = ::deflate(&zs, flush);
+				if (Z_STREAM_ERROR == zstat)
+					return false;
+				size_t const n = sizeof(z->out) - zs.avail_out;
+				if (n && static_cast<std::streamsize>(n) != down.sputn(z->out, n))
+					return false;
+				if (Z_FINISH == flush ? Z_STREAM_END == zstat : zs.avail_out != 0)
+					return true;
+			}
+		}
+
+	}
+}
+
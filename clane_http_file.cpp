@@ -7,8 +7,14 @@
 /** @file */
 
 #include "clane_http_file.hpp"
+#include "clane_http_message.hpp"
 #include "clane_mime.hpp"
-#include <boost/filesystem/fstream.hpp>
+#include <fcntl.h>
+#include <iterator>
+#include <limits>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace clane {
 	namespace http {
@@ -24,11 +30,7 @@ namespace clane {
 			}
 
 			// output:
-#ifdef CLANE_HAVE_STD_MULTIMAP_EMPLACE
 			rs.headers.emplace("content-type", "text/html; charset=utf-8");
-#else
-			rs.headers.insert(header("content-type", "text/html; charset=utf-8"));
-#endif
 			// FIXME: "Date"
 			// FIXME: "Last-Modified"
 			// FIXME: no caching
@@ -39,56 +41,582 @@ namespace clane {
 			rs << "</pre></body></html>\n";
 		}
 
-		void serve_file(response_ostream &rs, request &req, boost::filesystem::path const &path,
-			 	boost::filesystem::file_status const &stat) {
+		std::shared_ptr<file_cache::entry const> file_cache::lookup(std::string const &path) {
+			if (!capacity)
+				return load(path);
+			auto now = std::chrono::steady_clock::now();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				evict_expired(now);
+				auto p = slots.find(path);
+				if (p != slots.end())
+					return p->second.ent;
+			}
+
+			// Load the entry without holding the lock so that other lookups needn't
+			// wait on the file system. Concurrent misses for the same path may each
+			// load the entry; the last one wins.
+			auto ent = load(path);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			auto p = slots.find(path);
+			if (p != slots.end()) {
+				order.erase(p->second.pos);
+				slots.erase(p);
+			}
+			evict_expired(now);
+			while (slots.size() >= capacity) {
+				slots.erase(order.front());
+				order.pop_front();
+			}
+			order.push_back(path);
+			slots[path] = slot{ent, now + ttl, std::prev(order.end())};
+			return ent;
+		}
+
+		void file_cache::evict_expired(std::chrono::steady_clock::time_point now) {
+			// Entries expire in insertion order, so the front of the list is the
+			// first to go. Evicting them promptly closes the descriptors of files
+			// that are no longer requested.
+			while (!order.empty() && slots.find(order.front())->second.expiry <= now) {
+				slots.erase(order.front());
+				order.pop_front();
+			}
+		}
+
+		std::shared_ptr<file_cache::entry const> file_cache::lookup_metadata(std::string const &path) {
+			if (capacity) {
+				auto now = std::chrono::steady_clock::now();
+				std::lock_guard<std::mutex> lock(mutex);
+				evict_expired(now);
+				auto p = slots.find(path);
+				if (p != slots.end())
+					return p->second.ent;
+			}
+			auto ent = std::make_shared<entry>();
+			ent->error = 0;
+			ent->mode = 0;
+			ent->size = 0;
+			ent->mtime = timespec{};
+			struct ::stat st;
+			if (-1 == ::stat(path.c_str(), &st)) {
+				ent->error = errno;
+				return ent;
+			}
+			ent->mode = st.st_mode;
+			ent->size = st.st_size;
+			ent->mtime = st.st_mtim;
+			return ent;
+		}
+
+		std::shared_ptr<file_cache::entry const> file_cache::load(std::string const &path) {
+			auto ent = std::make_shared<entry>();
+			ent->error = 0;
+			ent->mode = 0;
+			ent->size = 0;
+			ent->mtime = timespec{};
+			auto fd = std::make_shared<posix::unique_fd>(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+			struct ::stat st;
+			if (-1 == *fd || -1 == ::fstat(*fd, &st)) {
+				ent->error = errno;
+				return ent;
+			}
+			ent->mode = st.st_mode;
+			ent->size = st.st_size;
+			ent->mtime = st.st_mtim;
+			if (S_ISREG(st.st_mode))
+				ent->fd = std::move(fd); // other file types are not served from a descriptor
+			return ent;
+		}
+
+		size_t file_cache::size() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return slots.size();
+		}
+
+		static bool is_weak_etag(std::string const &etag) {
+			return !etag.compare(0, 2, "W/");
+		}
+
+		std::shared_ptr<memory_file_cache::entry const> memory_file_cache::lookup(std::string const &path,
+		file_cache::entry const &file, std::string const &type_path) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto p = slots.find(path);
+				if (p != slots.end()) {
+					entry const &ent = *p->second.ent;
+					// An entry rendered with a weak entity tag goes stale once the tag
+					// would be strong, so that the entry agrees with responses served
+					// from the file.
+					if (ent.size == file.size && ent.mtime.tv_sec == file.mtime.tv_sec &&
+						ent.mtime.tv_nsec == file.mtime.tv_nsec && (!ent.weak_etag || is_weak_etag(file_etag(file)))) {
+						lru.splice(lru.begin(), lru, p->second.pos);
+						return p->second.ent;
+					}
+					// stale:
+					used -= cost(ent);
+					lru.erase(p->second.pos);
+					slots.erase(p);
+				}
+			}
+			if (file.error || !file.fd || static_cast<size_t>(file.size) > max_file_size)
+				return nullptr;
+
+			// Read the file without holding the lock.
+			auto ent = load(file, type_path);
+			if (!ent || cost(*ent) > budget)
+				return ent;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			auto p = slots.find(path);
+			if (p != slots.end()) {
+				used -= cost(*p->second.ent);
+				lru.erase(p->second.pos);
+				slots.erase(p);
+			}
+			used += cost(*ent);
+			lru.push_front(path);
+			slots[path] = slot{ent, lru.begin()};
+			while (used > budget) {
+				auto q = slots.find(lru.back());
+				used -= cost(*q->second.ent);
+				slots.erase(q);
+				lru.pop_back();
+			}
+			return ent;
+		}
+
+		std::shared_ptr<memory_file_cache::entry const> memory_file_cache::load(file_cache::entry const &file,
+		std::string const &type_path) {
+			auto ent = std::make_shared<entry>();
+			ent->size = file.size;
+			ent->mtime = file.mtime;
+			ent->body.resize(file.size);
+			off_t off = 0;
+			while (off < file.size) {
+				ssize_t n = TEMP_FAILURE_RETRY(::pread(*file.fd, &ent->body[off], file.size - off, off));
+				if (n <= 0)
+					return nullptr; // file error, or file is shorter than expected
+				off += n;
+			}
+			auto mimep = mime::default_map.find(boost::filesystem::path(type_path).extension().string());
+			if (mimep != mime::default_map.end())
+				ent->headers.insert(header("content-type", mimep->second));
+			ent->headers.insert(header("accept-ranges", "bytes"));
+			std::string etag = file_etag(file);
+			ent->weak_etag = is_weak_etag(etag);
+			ent->headers.insert(header("etag", std::move(etag)));
+			ent->headers.insert(header("last-modified", format_http_date(file.mtime.tv_sec)));
+			ent->headers.insert(header("content-length", std::to_string(ent->body.size())));
+			for (auto i = ent->headers.begin(); i != ent->headers.end(); ++i) {
+				append_1x_header_name(ent->header_lines, ent->headers.id(i), i->first);
+				ent->header_lines += ": " + i->second + "\r\n";
+			}
+			return ent;
+		}
+
+		size_t memory_file_cache::size() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return slots.size();
+		}
+
+		size_t memory_file_cache::bytes() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return used;
+		}
+
+		// Returns the server_streambuf that a response goes straight to, if any.
+		// A file is already in its final form, so the response skips on-the-fly
+		// compression, if it hasn't already begun.
+		static server_streambuf *direct_streambuf(response_ostream &rs) {
+			server_streambuf *sb = dynamic_cast<server_streambuf *>(rs.rdbuf());
+			if (sb)
+				return sb;
+			deflate_streambuf *zsb = dynamic_cast<deflate_streambuf *>(rs.rdbuf());
+			return zsb ? zsb->bypass() : nullptr;
+		}
+
+		void serve_memory_file(response_ostream &rs, memory_file_cache::entry const &ent) {
+			// If the response goes straight to a connection and the application
+			// hasn't set any of the content headers then send the whole response
+			// in one write.
+			server_streambuf *sb = direct_streambuf(rs);
+			if (sb && !rs.headers.count(header_id::content_type) && !rs.headers.count(header_id::content_length) &&
+				sb->send_prepared(ent.header_lines, ent.body.data(), ent.body.size()))
+				return;
+			for (auto i = ent.headers.begin(); i != ent.headers.end(); ++i)
+				rs.headers.insert(*i);
+			rs.write(ent.body.data(), ent.body.size());
+		}
+
+		std::string file_etag(file_cache::entry const &ent) {
+			bool const weak = !S_ISREG(ent.mode) || ent.mtime.tv_sec >= ::time(nullptr) - 1;
+			std::ostringstream ss;
+			ss << (weak ? "W/\"" : "\"") << std::hex << ent.size << '-' << ent.mtime.tv_sec << '.' <<
+				ent.mtime.tv_nsec << '"';
+			return ss.str();
+		}
+
+		// Compares two entity tags, ignoring whether either is weak.
+		static bool etag_weak_equal(char const *a, size_t alen, std::string const &b) {
+			if (alen >= 2 && 'W' == a[0] && '/' == a[1]) {
+				a += 2;
+				alen -= 2;
+			}
+			size_t boff = b.compare(0, 2, "W/") ? 0 : 2;
+			return alen == b.size() - boff && !b.compare(boff, alen, a, alen);
+		}
+
+		bool is_not_modified(request const &req, std::string const &etag, time_t mtime) {
+			if (!(request_method_id(req) & (method_get | method_head)))
+				return false;
+			auto inm = req.headers.find(header_id::if_none_match);
+			if (inm != req.headers.end()) {
+				std::string const &v = inm->second;
+				size_t pos = 0;
+				while (pos < v.size()) {
+					size_t end = v.find(',', pos);
+					if (std::string::npos == end)
+						end = v.size();
+					size_t first = v.find_first_not_of(" \t", pos);
+					size_t last = v.find_last_not_of(" \t", end - 1);
+					if (first < end && std::string::npos != last && last >= first) {
+						if (('*' == v[first] && first == last) || etag_weak_equal(&v[first], last - first + 1, etag))
+							return true;
+					}
+					pos = end + 1;
+				}
+				return false;
+			}
+			auto ims = req.headers.find(header_id::if_modified_since);
+			time_t since;
+			if (ims == req.headers.end() || !parse_http_date(ims->second, since))
+				return false;
+			// A date in the future can't be a date the client got from us.
+			return since <= ::time(nullptr) && mtime <= since;
+		}
+
+		// Adds a file's validators to a response. If the request's preconditions
+		// show that the client already has the current version of the file then
+		// makes the response 304 Not Modified and returns true.
+		static bool add_validators(response_ostream &rs, request const &req, file_cache::entry const &ent) {
+			std::string etag = file_etag(ent);
+			bool const not_modified = is_not_modified(req, etag, ent.mtime.tv_sec);
+			if (not_modified)
+				rs.status = status_code::not_modified;
+			rs.headers.insert(header("etag", std::move(etag)));
+			rs.headers.insert(header("last-modified", format_http_date(ent.mtime.tv_sec)));
+			return not_modified;
+		}
 
-			// FIXME: error handling?
-			// FIXME: caching
-			// FIXME: modified date
-			// FIXME: byte range
+		// Returns true if a Range request should be honored in light of its
+		// If-Range header, if any: the file must not have changed since the
+		// client got the given strong entity tag or modification date.
+		static bool is_range_current(request const &req, std::string const &etag, time_t mtime) {
+			auto ifr = req.headers.find(header_id::if_range);
+			if (ifr == req.headers.end())
+				return true;
+			std::string const &v = ifr->second;
+			if (!v.empty() && ('"' == v[0] || !v.compare(0, 2, "W/")))
+				return '"' == etag[0] && v == etag; // strong comparison
+			time_t date;
+			return parse_http_date(v, date) && date == mtime && '"' == etag[0];
+		}
+
+		bool parse_byte_ranges(std::string const &s, off_t size, std::vector<byte_range> &ranges) {
+			ranges.clear();
+			static char const unit[] = "bytes=";
+			if (s.compare(0, sizeof(unit)-1, unit))
+				return false; // not a byte range
+			auto const end = s.end();
+			auto pos = s.begin() + sizeof(unit)-1;
+			auto skip_ws = [&]() {
+				while (pos != end && (' ' == *pos || '\t' == *pos))
+					++pos;
+			};
+			auto parse_number = [&](off_t &n) -> bool {
+				if (pos == end || *pos < '0' || *pos > '9')
+					return false;
+				n = 0;
+				for (; pos != end && *pos >= '0' && *pos <= '9'; ++pos) {
+					off_t const d = *pos - '0';
+					if (n > (std::numeric_limits<off_t>::max() - d) / 10)
+						return false; // overflow
+					n = n * 10 + d;
+				}
+				return true;
+			};
+			bool any = false;
+			while (true) {
+				skip_ws();
+				if (pos == end)
+					break;
+				if (',' == *pos) {
+					++pos; // empty list element
+					continue;
+				}
+				off_t first = 0, last = 0;
+				bool has_first = parse_number(first);
+				if (pos == end || '-' != *pos)
+					return false;
+				++pos;
+				bool has_last = parse_number(last);
+				if (pos != end && *pos >= '0' && *pos <= '9')
+					return false; // overflow
+				if (has_first) {
+					if (has_last && last < first)
+						return false;
+					if (!has_last || last >= size)
+						last = size - 1;
+					if (first < size)
+						ranges.push_back(byte_range{first, last});
+				} else {
+					// suffix range: the last n bytes
+					if (!has_last)
+						return false;
+					if (last && size)
+						ranges.push_back(byte_range{last < size ? size - last : 0, size - 1});
+				}
+				any = true;
+				skip_ws();
+				if (pos == end)
+					break;
+				if (',' != *pos)
+					return false;
+				++pos;
+			}
+			return any;
+		}
+
+		// Sends part of a file as response body data.
+		static void send_slice(response_ostream &rs, file_cache::entry const &ent, off_t offset, off_t size) {
+			// If the response goes straight to a connection then the connection
+			// sends the file using sendfile(2), without copying it through user
+			// space. Otherwise, e.g., for a recorded response, copy the file through
+			// the stream. Either way, reads use explicit offsets so that requests
+			// may share the open file.
+			server_streambuf *sb = direct_streambuf(rs);
+			if (sb) {
+				if (!sb->send_file(ent.fd, offset, size))
+					rs.setstate(std::ios_base::badbit);
+				return;
+			}
+			char buf[64 * 1024];
+			off_t const end = offset + size;
+			while (offset < end && rs) {
+				ssize_t n = TEMP_FAILURE_RETRY(::pread(*ent.fd, buf, std::min<off_t>(sizeof(buf), end - offset), offset));
+				if (n <= 0) {
+					rs.setstate(std::ios_base::badbit); // file error, or file is shorter than expected
+					return;
+				}
+				rs.write(buf, n);
+				offset += n;
+			}
+		}
+
+		void serve_file(response_ostream &rs, request &req, boost::filesystem::path const &path,
+			 	file_cache::entry const &ent) {
 
 			// file-type check:
-			if (stat.type() != boost::filesystem::regular_file &&
-			    stat.type() != boost::filesystem::symlink_file) {
+			if (ent.error) {
+				rs.status = EACCES == ent.error ? status_code::forbidden : status_code::not_found;
+				return;
+			}
+			if (!S_ISREG(ent.mode)) {
 				rs.status = status_code::not_found;
 				return;
 			}
 
+			// validators:
+			if (add_validators(rs, req, ent))
+				return;
+			if (!ent.fd) {
+				rs.status = status_code::internal_server_error; // metadata only
+				return;
+			}
+
+			// The file goes out as is, never compressed on the fly, even if a
+			// multipart response writes part headers through the stream.
+			direct_streambuf(rs);
+
 			// content-type:
+			std::string content_type;
 			auto mimep = mime::default_map.find(path.extension().string());
-			if (mimep != mime::default_map.end()) {
-#ifdef CLANE_HAVE_STD_MULTIMAP_EMPLACE
-				rs.headers.emplace("content-type", mimep->second);
-#else
-				rs.headers.insert(header("content-type", mimep->second));
-#endif
+			if (mimep != mime::default_map.end())
+				content_type = mimep->second;
+
+			rs.headers.insert(header("accept-ranges", "bytes"));
+
+			// Serve only the requested byte ranges, if any. Ignore a malformed
+			// Range header, one asking for an unreasonable number of ranges, or one
+			// whose If-Range condition fails.
+			static size_t const max_ranges = 32;
+			std::vector<byte_range> ranges;
+			auto rangep = req.headers.find(header_id::range);
+			if (rangep == req.headers.end() || method_get != request_method_id(req) ||
+				!is_range_current(req, rs.headers.find(header_id::etag)->second, ent.mtime.tv_sec) ||
+				!parse_byte_ranges(rangep->second, ent.size, ranges) || ranges.size() > max_ranges) {
+				if (!content_type.empty())
+					rs.headers.insert(header("content-type", content_type));
+				rs.headers.insert(header("content-length", std::to_string(ent.size)));
+				send_slice(rs, ent, 0, ent.size);
+				return;
 			}
 
-			// content-length:
-			std::ostringstream ss;
-			ss << boost::filesystem::file_size(path);
-#ifdef CLANE_HAVE_STD_MULTIMAP_EMPLACE
-			rs.headers.emplace("content-length", ss.str());
-#else
-			rs.headers.insert(header("content-length", ss.str()));
-#endif
+			// unsatisfiable:
+			if (ranges.empty()) {
+				rs.status = status_code::requested_range_not_satisfiable;
+				rs.headers.insert(header("content-range", "bytes */" + std::to_string(ent.size)));
+				return;
+			}
+
+			rs.status = status_code::partial_content;
+			auto content_range = [&](byte_range const &r) {
+				return "bytes " + std::to_string(r.first) + '-' + std::to_string(r.last) + '/' + std::to_string(ent.size);
+			};
+
+			// single range:
+			if (1 == ranges.size()) {
+				if (!content_type.empty())
+					rs.headers.insert(header("content-type", content_type));
+				rs.headers.insert(header("content-range", content_range(ranges[0])));
+				rs.headers.insert(header("content-length", std::to_string(ranges[0].last - ranges[0].first + 1)));
+				send_slice(rs, ent, ranges[0].first, ranges[0].last - ranges[0].first + 1);
+				return;
+			}
 
-			// content:
-			boost::filesystem::ifstream in(path);
-			rs << in.rdbuf();
+			// multiple ranges, as multipart/byteranges:
+			std::ostringstream bss;
+			bss << "clane-byteranges-" << std::hex <<
+				std::chrono::steady_clock::now().time_since_epoch().count() << '-' << ent.size;
+			std::string const boundary = bss.str();
+			std::vector<std::string> part_hdrs;
+			off_t content_len = 0;
+			for (auto i = ranges.begin(); i != ranges.end(); ++i) {
+				std::string h = (i == ranges.begin() ? "--" : "\r\n--") + boundary + "\r\n";
+				if (!content_type.empty())
+					h += "Content-Type: " + content_type + "\r\n";
+				h += "Content-Range: " + content_range(*i) + "\r\n\r\n";
+				content_len += h.size() + (i->last - i->first + 1);
+				part_hdrs.push_back(std::move(h));
+			}
+			std::string const close = "\r\n--" + boundary + "--\r\n";
+			content_len += close.size();
+			rs.headers.insert(header("content-type", "multipart/byteranges; boundary=" + boundary));
+			rs.headers.insert(header("content-length", std::to_string(content_len)));
+			for (size_t i = 0; i < ranges.size(); ++i) {
+				rs << part_hdrs[i];
+				send_slice(rs, ent, ranges[i].first, ranges[i].last - ranges[i].first + 1);
+			}
+			rs << close;
 		}
 
 		void serve_file(response_ostream &rs, request &req, boost::filesystem::path const &path) {
-			serve_file(rs, req, path, boost::filesystem::status(path));
+			serve_file(rs, req, path, *file_cache::load(path.string()));
+		}
+
+		// Precompressed sidecar files, in order of preference
+		static struct {
+			char const *suffix;
+			char const *coding;
+		} const sidecars[] = {
+			{".br", "br"},
+			{".gz", "gzip"},
+		};
+
+		size_t file_server::default_cache_capacity() {
+			// Cached descriptors count against the process's descriptor limit, so
+			// leave most of it for connections.
+			struct ::rlimit rl;
+			if (-1 == ::getrlimit(RLIMIT_NOFILE, &rl) || RLIM_INFINITY == rl.rlim_cur)
+				return max_default_cache_capacity;
+			if (rl.rlim_cur / 16 >= max_default_cache_capacity)
+				return max_default_cache_capacity;
+			return rl.rlim_cur / 16;
+		}
+
+		file_server::file_server(boost::filesystem::path const &root_path):
+			root_path{root_path}, cache{std::make_shared<file_cache>(default_cache_capacity(), std::chrono::seconds(1))} {}
+
+		file_server::file_server(boost::filesystem::path const &root_path, size_t cache_capacity,
+			std::chrono::steady_clock::duration cache_ttl, size_t memory_budget, size_t memory_max_file_size):
+			root_path{root_path}, cache{std::make_shared<file_cache>(cache_capacity, cache_ttl)} {
+			if (memory_budget)
+				mem_cache = std::make_shared<memory_file_cache>(memory_budget, memory_max_file_size);
 		}
 
 		void file_server::operator()(response_ostream &rs, request &req) {
-			boost::filesystem::directory_entry ent(root_path / req.uri.path);
-			auto stat = ent.status();
-			if (stat.type() == boost::filesystem::directory_file)
-				serve_dir(rs, req, root_path / req.uri.path);
-			else
-				serve_file(rs, req, root_path / req.uri.path, stat);
+			boost::filesystem::path path = root_path / req.uri.path;
+
+			// A conditional request starts with the files' metadata so that
+			// revalidating an unchanged file needn't open it, even if it isn't
+			// cached.
+			bool const conditional = (request_method_id(req) & (method_get | method_head)) &&
+				(req.headers.count(header_id::if_none_match) || req.headers.count(header_id::if_modified_since));
+			auto find = [&](std::string const &p) {
+				return conditional ? cache->lookup_metadata(p) : cache->lookup(p);
+			};
+
+			auto ent = find(path.string());
+			if (!ent->error && S_ISDIR(ent->mode)) {
+				if (!add_validators(rs, req, *ent))
+					serve_dir(rs, req, path);
+				return;
+			}
+
+			// Serve a precompressed sidecar file in place of the file if the client
+			// accepts its encoding at least as well as it accepts the unencoded file.
+			// The content type still comes from the file's own extension.
+			std::string file_path = path.string();
+			if (!ent->error && S_ISREG(ent->mode)) {
+				auto ae = req.headers.find(header_id::accept_encoding);
+				float best_q = ae == req.headers.end() ? 1.0f : accept_encoding_quality(ae->second, "identity");
+				bool has_sidecar = false;
+				char const *coding = nullptr;
+				std::string coded_path;
+				for (size_t i = 0; i < sizeof(sidecars) / sizeof(sidecars[0]); ++i) {
+					std::string const sidecar_path = path.string() + sidecars[i].suffix;
+					auto sidecar = find(sidecar_path);
+					if (sidecar->error || !S_ISREG(sidecar->mode))
+						continue;
+					has_sidecar = true;
+					if (ae == req.headers.end())
+						break;
+					float const q = accept_encoding_quality(ae->second, sidecars[i].coding);
+					if (q > 0.0f && (q > best_q || (q == best_q && !coding))) {
+						best_q = q;
+						coding = sidecars[i].coding;
+						coded_path = sidecar_path;
+						ent = std::move(sidecar);
+					}
+				}
+				if (has_sidecar)
+					rs.headers.insert(header("vary", "accept-encoding"));
+				if (coding) {
+					rs.headers.insert(header("content-encoding", coding));
+					file_path = std::move(coded_path);
+				}
+			}
+
+			// Answer a conditional request for an unchanged file from its metadata
+			// alone. Otherwise, open the file.
+			if (!ent->error && S_ISREG(ent->mode)) {
+				if (is_not_modified(req, file_etag(*ent), ent->mtime.tv_sec)) {
+					serve_file(rs, req, path, *ent);
+					return;
+				}
+				if (!ent->fd)
+					ent = cache->lookup(file_path);
+			}
+
+			if (mem_cache && req.headers.end() == req.headers.find(header_id::range)) {
+				auto mem_ent = mem_cache->lookup(file_path, *ent, path.string());
+				if (mem_ent) {
+					serve_memory_file(rs, *mem_ent);
+					return;
+				}
+			}
+			serve_file(rs, req, path, *ent);
 		}
 
 	}
@@ -12,13 +12,134 @@
 #include "clane_base.hpp"
 #include "clane_http_server.hpp"
 #include "include/clane_http_file.hpp"
+#include <list>
+#include <sys/stat.h>
 
 namespace clane {
 	namespace http {
 
+		// Bounded cache of open files and their metadata, keyed by path. Entries
+		// expire after a fixed time so that the cache eventually notices changes
+		// to the file system. Lookups are thread-safe.
+		class file_cache {
+		public:
+			struct entry {
+				int error; // errno value from opening the file, or zero
+				mode_t mode;
+				off_t size;
+				timespec mtime;
+				std::shared_ptr<posix::unique_fd> fd; // open file, for regular files only
+			};
+		private:
+			typedef std::list<std::string> fifo; // keys, in order of expiration
+			struct slot {
+				std::shared_ptr<entry const> ent;
+				std::chrono::steady_clock::time_point expiry;
+				fifo::iterator pos;
+			};
+			std::mutex mutex;
+			std::unordered_map<std::string, slot> slots;
+			fifo order;
+			size_t capacity;
+			std::chrono::steady_clock::duration ttl;
+		public:
+			~file_cache() = default;
+			file_cache(size_t capacity, std::chrono::steady_clock::duration ttl): capacity{capacity}, ttl{ttl} {}
+			file_cache(file_cache const &) = delete;
+			file_cache &operator=(file_cache const &) = delete;
+			std::shared_ptr<entry const> lookup(std::string const &path);
+
+			// Returns the cached entry for a path, if any, or else the file's
+			// metadata without opening the file. The metadata entry has no
+			// descriptor and isn't cached.
+			std::shared_ptr<entry const> lookup_metadata(std::string const &path);
+
+			static std::shared_ptr<entry const> load(std::string const &path);
+			size_t size();
+		private:
+			void evict_expired(std::chrono::steady_clock::time_point now);
+		};
+
+		// Memory-resident copies of small files, each with its content headers
+		// already rendered, evicted in least-recently-used order to stay within a
+		// byte budget. An entry is valid only while the file's size and
+		// modification time, as reported by the file_cache, are unchanged, and
+		// only until its entity tag, if weak, would now be strong. The content
+		// type comes from the extension of a given type path, which differs from
+		// the file's path for precompressed sidecar files. Lookups are
+		// thread-safe.
+		class memory_file_cache {
+		public:
+			struct entry {
+				off_t size;
+				timespec mtime;
+				header_map headers; // content-type and content-length
+				std::string header_lines; // headers, rendered as HTTP/1.x header lines
+				std::string body;
+				bool weak_etag;
+			};
+		private:
+			typedef std::list<std::string> lru_list; // keys, most recently used first
+			struct slot {
+				std::shared_ptr<entry const> ent;
+				lru_list::iterator pos;
+			};
+			std::mutex mutex;
+			std::unordered_map<std::string, slot> slots;
+			lru_list lru;
+			size_t budget;
+			size_t used;
+		public:
+			size_t const max_file_size;
+		public:
+			~memory_file_cache() = default;
+			memory_file_cache(size_t budget, size_t max_file_size): budget{budget}, used{}, max_file_size{max_file_size} {}
+			memory_file_cache(memory_file_cache const &) = delete;
+			memory_file_cache &operator=(memory_file_cache const &) = delete;
+			std::shared_ptr<entry const> lookup(std::string const &path, file_cache::entry const &file) {
+				return lookup(path, file, path);
+			}
+			std::shared_ptr<entry const> lookup(std::string const &path, file_cache::entry const &file,
+				std::string const &type_path);
+			size_t size();
+			size_t bytes();
+		private:
+			static std::shared_ptr<entry const> load(file_cache::entry const &file, std::string const &type_path);
+			static size_t cost(entry const &ent) { return ent.header_lines.size() + ent.body.size(); }
+		};
+
+		// Returns an entity tag for the current version of a file, derived from
+		// its size and modification time. The tag is weak if the file isn't a
+		// regular file or was modified within the last second, in which case the
+		// file could change again without its modification time changing.
+		std::string file_etag(file_cache::entry const &ent);
+
+		// Returns true if a GET or HEAD request's preconditions show that the
+		// client's copy of a file is current: If-None-Match lists the file's
+		// entity tag or, lacking If-None-Match, the file hasn't changed since
+		// If-Modified-Since.
+		bool is_not_modified(request const &req, std::string const &etag, time_t mtime);
+
+		// Inclusive range of byte offsets within a file
+		struct byte_range {
+			off_t first;
+			off_t last;
+		};
+
+		// Parses the value of a Range header for a file of the given size. Returns
+		// false if the header should be ignored: the header is malformed or isn't
+		// for bytes. Otherwise, fills ranges with the satisfiable ranges, which is
+		// empty if none are satisfiable.
+		bool parse_byte_ranges(std::string const &s, off_t size, std::vector<byte_range> &ranges);
+
 		void serve_dir(response_ostream &rs, request &req, boost::filesystem::path const &path);
 		void serve_file(response_ostream &rs, request &req, boost::filesystem::path const &path);
 
+		// Serves a file from its cache entry. An entry without a descriptor, from
+		// file_cache::lookup_metadata(), suffices only to answer 304 Not Modified.
+		void serve_file(response_ostream &rs, request &req, boost::filesystem::path const &path,
+			file_cache::entry const &ent);
+
 	}
 }
 
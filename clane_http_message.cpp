@@ -7,6 +7,12 @@
 /** @file */
 
 #include "clane_http_message.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 
 namespace clane {
 	namespace http {
@@ -67,6 +73,365 @@ namespace clane {
 			return "";
 		}
 
+		method_set parse_method(std::string const &s) {
+			struct entry {
+				char const *name;
+				method_set id;
+			};
+			static entry const methods[] = {
+				{"GET", method_get},
+				{"HEAD", method_head},
+				{"POST", method_post},
+				{"PUT", method_put},
+				{"DELETE", method_delete},
+				{"CONNECT", method_connect},
+				{"OPTIONS", method_options},
+				{"TRACE", method_trace},
+				{"PATCH", method_patch}
+			};
+			for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); ++i) {
+				if (s == methods[i].name)
+					return methods[i].id;
+			}
+			return method_other;
+		}
+
+		// HTTP 1.x spellings of the well-known header names, in header_id order
+		static char const *const known_header_names[] = {
+			"Accept",
+			"Accept-Charset",
+			"Accept-Encoding",
+			"Accept-Language",
+			"Accept-Ranges",
+			"Access-Control-Allow-Credentials",
+			"Access-Control-Allow-Headers",
+			"Access-Control-Allow-Methods",
+			"Access-Control-Allow-Origin",
+			"Access-Control-Expose-Headers",
+			"Access-Control-Max-Age",
+			"Access-Control-Request-Headers",
+			"Access-Control-Request-Method",
+			"Age",
+			"Allow",
+			"Authorization",
+			"Cache-Control",
+			"Connection",
+			"Content-Disposition",
+			"Content-Encoding",
+			"Content-Language",
+			"Content-Length",
+			"Content-Location",
+			"Content-Md5",
+			"Content-Range",
+			"Content-Security-Policy",
+			"Content-Type",
+			"Cookie",
+			"Date",
+			"Dnt",
+			"Etag",
+			"Expect",
+			"Expires",
+			"Forwarded",
+			"From",
+			"Host",
+			"If-Match",
+			"If-Modified-Since",
+			"If-None-Match",
+			"If-Range",
+			"If-Unmodified-Since",
+			"Keep-Alive",
+			"Last-Modified",
+			"Link",
+			"Location",
+			"Max-Forwards",
+			"Origin",
+			"Pragma",
+			"Proxy-Authenticate",
+			"Proxy-Authorization",
+			"Range",
+			"Referer",
+			"Retry-After",
+			"Server",
+			"Set-Cookie",
+			"Strict-Transport-Security",
+			"Te",
+			"Trailer",
+			"Transfer-Encoding",
+			"Upgrade",
+			"Upgrade-Insecure-Requests",
+			"User-Agent",
+			"Vary",
+			"Via",
+			"Warning",
+			"Www-Authenticate",
+			"X-Content-Type-Options",
+			"X-Forwarded-For",
+			"X-Forwarded-Host",
+			"X-Forwarded-Proto",
+			"X-Frame-Options",
+			"X-Requested-With",
+		};
+
+		static_assert(sizeof(known_header_names) / sizeof(known_header_names[0]) ==
+			static_cast<size_t>(header_id::unknown), "every well-known header needs a name");
+
+		// Perfect-hash table of the well-known header names. The hash function
+		// looks at the name's length and four of its characters, case folded,
+		// and its coefficients were chosen so that no two well-known names
+		// share a slot. The table is built at startup, like the token
+		// character table.
+		static class known_header_table {
+			static size_t const slot_count = 256;
+			header_id slots[slot_count];
+			unsigned char sizes[static_cast<size_t>(header_id::unknown)];
+		public:
+			static size_t hash(char const *name, size_t size) {
+				return (size + 5 * (name[0] | 0x20) + 5 * (name[size/2] | 0x20) + 10 * (name[size-2] | 0x20) +
+					10 * (name[size-1] | 0x20)) % slot_count;
+			}
+
+			known_header_table() {
+				std::fill(slots, slots + slot_count, header_id::unknown);
+				for (size_t i = 0; i < static_cast<size_t>(header_id::unknown); ++i) {
+					size_t const size = std::strlen(known_header_names[i]);
+					size_t const slot = hash(known_header_names[i], size);
+					assert(header_id::unknown == slots[slot]); // else the hash isn't perfect
+					slots[slot] = static_cast<header_id>(i);
+					sizes[i] = size;
+				}
+			}
+
+			header_id find(char const *name, size_t size) const {
+				if (size < 2)
+					return header_id::unknown;
+				header_id const id = slots[hash(name, size)];
+				if (header_id::unknown == id || sizes[static_cast<size_t>(id)] != size ||
+				ascii::icase_compare(name, name + size, known_header_names[static_cast<size_t>(id)],
+					known_header_names[static_cast<size_t>(id)] + size))
+					return header_id::unknown;
+				return id;
+			}
+		} known_headers;
+
+		header_id find_header_id(char const *name, size_t size) {
+			return known_headers.find(name, size);
+		}
+
+		char const *header_name(header_id id) {
+			if (header_id::unknown == id)
+				return nullptr;
+			return known_header_names[static_cast<size_t>(id)];
+		}
+
+		header_map::~header_map() {
+			clear();
+			if (hdrs != reinterpret_cast<header *>(inline_hdrs)) {
+				::operator delete(hdrs);
+				delete[] hashes;
+			}
+		}
+
+		header_map::header_map(std::initializer_list<header> il):
+			hdrs{reinterpret_cast<header *>(inline_hdrs)}, hashes{inline_hashes}, size_{}, capacity_{inline_capacity} {
+			insert(il.begin(), il.end());
+		}
+
+		header_map::header_map(header_map const &that):
+			hdrs{reinterpret_cast<header *>(inline_hdrs)}, hashes{inline_hashes}, size_{}, capacity_{inline_capacity} {
+			reserve(that.size_);
+			for (size_t i = 0; i < that.size_; ++i) {
+				new (hdrs + i) header(that.hdrs[i]);
+				hashes[i] = that.hashes[i];
+				++size_;
+			}
+		}
+
+		header_map &header_map::operator=(header_map const &that) {
+			if (this != &that) {
+				header_map tmp(that);
+				clear();
+				move_from(tmp);
+			}
+			return *this;
+		}
+
+		header_map::header_map(header_map &&that) noexcept:
+			hdrs{reinterpret_cast<header *>(inline_hdrs)}, hashes{inline_hashes}, size_{}, capacity_{inline_capacity} {
+			move_from(that);
+		}
+
+		header_map &header_map::operator=(header_map &&that) noexcept {
+			if (this != &that) {
+				clear();
+				move_from(that);
+			}
+			return *this;
+		}
+
+		void header_map::swap(header_map &that) noexcept {
+			header_map tmp(std::move(that));
+			that = std::move(*this);
+			*this = std::move(tmp);
+		}
+
+		void header_map::move_from(header_map &that) noexcept {
+			// This map is empty. Take the other map's array if it has allocated one;
+			// otherwise, move the headers one by one.
+			if (that.hdrs != reinterpret_cast<header *>(that.inline_hdrs)) {
+				if (hdrs != reinterpret_cast<header *>(inline_hdrs)) {
+					::operator delete(hdrs);
+					delete[] hashes;
+				}
+				hdrs = that.hdrs;
+				hashes = that.hashes;
+				size_ = that.size_;
+				capacity_ = that.capacity_;
+				that.hdrs = reinterpret_cast<header *>(that.inline_hdrs);
+				that.hashes = that.inline_hashes;
+				that.size_ = 0;
+				that.capacity_ = inline_capacity;
+				return;
+			}
+			for (size_t i = 0; i < that.size_; ++i) {
+				new (hdrs + i) header(std::move(that.hdrs[i]));
+				hashes[i] = that.hashes[i];
+			}
+			size_ = that.size_;
+			that.clear();
+		}
+
+		header_map::iterator header_map::insert(header &&h) {
+			size_t const hash = header_name_hash(h.first);
+			size_t const pos = upper_bound_index(h.first);
+			reserve(size_ + 1);
+			if (pos == size_) {
+				new (hdrs + size_) header(std::move(h));
+			} else {
+				new (hdrs + size_) header(std::move(hdrs[size_-1]));
+				std::move_backward(hdrs + pos, hdrs + size_ - 1, hdrs + size_);
+				hdrs[pos] = std::move(h);
+				std::memmove(hashes + pos + 1, hashes + pos, (size_ - pos) * sizeof(*hashes));
+			}
+			hashes[pos] = hash;
+			++size_;
+			return hdrs + pos;
+		}
+
+		header_map::iterator header_map::erase(const_iterator first, const_iterator last) {
+			size_t const pos = first - hdrs;
+			size_t const n = last - first;
+			if (!n)
+				return hdrs + pos;
+			std::move(hdrs + pos + n, hdrs + size_, hdrs + pos);
+			for (size_t i = size_ - n; i < size_; ++i)
+				hdrs[i].~header();
+			std::memmove(hashes + pos, hashes + pos + n, (size_ - pos - n) * sizeof(*hashes));
+			size_ -= n;
+			return hdrs + pos;
+		}
+
+		size_t header_map::erase(std::string const &name) {
+			auto r = equal_range(name);
+			size_t const n = r.second - r.first;
+			erase(r.first, r.second);
+			return n;
+		}
+
+		size_t header_map::erase(header_id id) {
+			auto r = equal_range(id);
+			size_t const n = r.second - r.first;
+			erase(r.first, r.second);
+			return n;
+		}
+
+		void header_map::clear() {
+			for (size_t i = 0; i < size_; ++i)
+				hdrs[i].~header();
+			size_ = 0;
+		}
+
+		std::pair<header_map::iterator, header_map::iterator> header_map::equal_range(std::string const &name) {
+			auto r = const_cast<header_map const *>(this)->equal_range(name);
+			return std::make_pair(hdrs + (r.first - hdrs), hdrs + (r.second - hdrs));
+		}
+
+		std::pair<header_map::const_iterator, header_map::const_iterator>
+		header_map::equal_range(std::string const &name) const {
+			size_t const hash = header_name_hash(name);
+			bool const known = hash < static_cast<size_t>(header_id::unknown);
+			size_t const first = find_index(name, hash);
+			size_t last = first;
+			if (first < size_) {
+				// Headers with the same name are adjacent.
+				++last;
+				while (last < size_ && hashes[last] == hash && (known || !ascii::icase_compare(hdrs[last].first, name)))
+					++last;
+			}
+			return std::make_pair(hdrs + first, hdrs + last);
+		}
+
+		std::pair<header_map::iterator, header_map::iterator> header_map::equal_range(header_id id) {
+			auto r = const_cast<header_map const *>(this)->equal_range(id);
+			return std::make_pair(hdrs + (r.first - hdrs), hdrs + (r.second - hdrs));
+		}
+
+		std::pair<header_map::const_iterator, header_map::const_iterator> header_map::equal_range(header_id id) const {
+			size_t const first = find_index(id);
+			size_t last = first;
+			while (last < size_ && hashes[last] == static_cast<size_t>(id))
+				++last;
+			return std::make_pair(hdrs + first, hdrs + last);
+		}
+
+		size_t header_map::find_index(std::string const &name, size_t hash) const {
+			if (hash < static_cast<size_t>(header_id::unknown))
+				return find_index(static_cast<header_id>(hash));
+			for (size_t i = 0; i < size_; ++i) {
+				if (hashes[i] == hash && !ascii::icase_compare(hdrs[i].first, name))
+					return i;
+			}
+			return size_;
+		}
+
+		size_t header_map::find_index(header_id id) const {
+			if (header_id::unknown == id)
+				return size_;
+			return std::find(hashes, hashes + size_, static_cast<size_t>(id)) - hashes;
+		}
+
+		size_t header_map::upper_bound_index(std::string const &name) const {
+			size_t lo = 0;
+			size_t hi = size_;
+			while (lo < hi) {
+				size_t const mid = lo + (hi - lo) / 2;
+				if (ascii::icase_compare(name, hdrs[mid].first) < 0)
+					hi = mid;
+				else
+					lo = mid + 1;
+			}
+			return lo;
+		}
+
+		void header_map::reserve(size_t n) {
+			if (n <= capacity_)
+				return;
+			size_t const cap = std::max(n, capacity_ * 2);
+			header *const new_hdrs = static_cast<header *>(::operator new(cap * sizeof(header)));
+			size_t *const new_hashes = new size_t[cap];
+			for (size_t i = 0; i < size_; ++i) {
+				new (new_hdrs + i) header(std::move(hdrs[i]));
+				hdrs[i].~header();
+			}
+			std::memcpy(new_hashes, hashes, size_ * sizeof(*hashes));
+			if (hdrs != reinterpret_cast<header *>(inline_hdrs)) {
+				::operator delete(hdrs);
+				delete[] hashes;
+			}
+			hdrs = new_hdrs;
+			hashes = new_hashes;
+			capacity_ = cap;
+		}
+
 		void canonize_1x_header_name(char *beg, char *end) {
 			bool cap = true;
 			char *i = beg;
@@ -82,6 +447,101 @@ namespace clane {
 				++i;
 			}
 		}
+		void append_1x_header_name(std::string &s, header_id id, std::string const &name) {
+			if (header_id::unknown != id) {
+				s.append(header_name(id));
+				return;
+			}
+			size_t const n = s.size();
+			s.append(name);
+			canonize_1x_header_name(&s[n], &s[s.size()]);
+		}
+
+
+		static char const *const day_names[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+		static char const *const month_names[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep",
+			"Oct", "Nov", "Dec"};
+
+		std::string format_http_date(time_t t) {
+			// Format by hand rather than with strftime, whose day and month names
+			// depend on the locale.
+			struct tm tm;
+			::gmtime_r(&t, &tm);
+			char buf[32];
+			std::snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT", day_names[tm.tm_wday], tm.tm_mday,
+				month_names[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+			return buf;
+		}
+
+		bool parse_http_date(std::string const &s, time_t &t) {
+			struct tm tm{};
+			char mon[4] = {};
+			int n = -1;
+			if (6 == std::sscanf(s.c_str(), "%*3[A-Za-z], %2d %3[A-Za-z] %4d %2d:%2d:%2d GMT%n", &tm.tm_mday, mon,
+				&tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &n) && n == static_cast<int>(s.size())) {
+				// IMF-fixdate
+			} else if (n = -1, 6 == std::sscanf(s.c_str(), "%*[A-Za-z], %2d-%3[A-Za-z]-%2d %2d:%2d:%2d GMT%n",
+				&tm.tm_mday, mon, &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &n) && n == static_cast<int>(s.size())) {
+				// RFC 850: a two-digit year that appears to be more than 50 years in
+				// the future is in the past.
+				struct tm now;
+				time_t now_t = ::time(nullptr);
+				::gmtime_r(&now_t, &now);
+				tm.tm_year += (now.tm_year + 1900) / 100 * 100;
+				if (tm.tm_year > now.tm_year + 1900 + 50)
+					tm.tm_year -= 100;
+			} else if (n = -1, 6 == std::sscanf(s.c_str(), "%*3[A-Za-z] %3[A-Za-z] %2d %2d:%2d:%2d %4d%n", mon,
+				&tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &tm.tm_year, &n) && n == static_cast<int>(s.size())) {
+				// asctime
+			} else {
+				return false;
+			}
+			tm.tm_mon = -1;
+			for (int i = 0; i < 12; ++i) {
+				if (!std::strcmp(mon, month_names[i]))
+					tm.tm_mon = i;
+			}
+			if (-1 == tm.tm_mon || tm.tm_mday < 1 || tm.tm_mday > 31 || tm.tm_hour < 0 || tm.tm_hour > 23 ||
+				tm.tm_min < 0 || tm.tm_min > 59 || tm.tm_sec < 0 || tm.tm_sec > 60 || tm.tm_year < 0)
+				return false;
+			tm.tm_year -= 1900;
+			t = ::timegm(&tm);
+			return true;
+		}
+
+		float accept_encoding_quality(std::string const &accept_encoding, std::string const &coding) {
+			float q_star = -1.0f;
+			char const *p = accept_encoding.c_str();
+			char const *const end = p + accept_encoding.size();
+			while (p < end) {
+				char const *elem_end = std::find(p, end, ',');
+				p = ascii::skip_whitespace(p, elem_end);
+				char const *name_end = p;
+				while (name_end < elem_end && ';' != *name_end && ' ' != *name_end && '\t' != *name_end)
+					++name_end;
+				if (name_end > p) {
+					float q = 1.0f;
+					char const *param = std::find(name_end, elem_end, ';');
+					if (param < elem_end) {
+						param = ascii::skip_whitespace(param + 1, elem_end);
+						char *qend;
+						if (elem_end - param >= 2 && ('q' == *param || 'Q' == *param) && '=' == param[1]) {
+							q = std::strtof(param + 2, &qend);
+							if (qend == param + 2 || q < 0.0f || q > 1.0f)
+								q = 0.0f;
+						}
+					}
+					if (1 == name_end - p && '*' == *p)
+						q_star = q;
+					else if (!ascii::icase_compare(p, name_end, coding.data(), coding.data() + coding.size()))
+						return q;
+				}
+				p = elem_end + 1;
+			}
+			if (q_star >= 0.0f)
+				return q_star;
+			return ascii::icase_compare(coding, std::string("identity")) ? 0.0f : 1.0f;
+		}
 
 	}
 }
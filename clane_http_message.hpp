@@ -13,6 +13,7 @@
 #include "clane_base.hpp"
 #include "clane_uri.hpp"
 #include "include/clane_http_pub.hpp"
+#include <ctime>
 
 namespace clane {
 	namespace http {
@@ -26,6 +27,33 @@ namespace clane {
 			return s;
 		}
 
+		/** @brief Appends a header name to a string, with HTTP 1.x header name
+		 * capitalization
+		 *
+		 * @remark A well-known name is copied from the interned spelling instead
+		 * of being rewritten. */
+		void append_1x_header_name(std::string &s, header_id id, std::string const &name);
+
+		/** @brief Formats a time as an HTTP-date in the preferred IMF-fixdate
+		 * format—e.g., <code>"Sun, 06 Nov 1994 08:49:37 GMT"</code>. */
+		std::string format_http_date(time_t t);
+
+		/** @brief Parses an HTTP-date in any of the IMF-fixdate, RFC 850, or
+		 * asctime formats
+		 *
+		 * @return Returns true and sets @p t if @p s is a valid HTTP-date, or
+		 * else returns false. */
+		bool parse_http_date(std::string const &s, time_t &t);
+
+		/** @brief Returns the quality value that an Accept-Encoding header
+		 * assigns a content coding
+		 *
+		 * @remark A coding the header doesn't list gets the quality of the
+		 * <code>"*"</code> element, if any, or else zero—except for
+		 * <code>"identity"</code>, which is acceptable unless excluded. A
+		 * malformed quality value counts as zero. */
+		float accept_encoding_quality(std::string const &accept_encoding, std::string const &coding);
+
 		class response {
 		public:
 			int major_version;
@@ -9,7 +9,7 @@
 #include "clane_ascii.hpp"
 #include "clane_http_parse.hpp"
 #include <cstring>
-#include <sstream>
+#include <limits>
 
 namespace clane {
 	namespace http {
@@ -59,10 +59,14 @@ namespace clane {
 		// Returns whether a given string comprises valid token characters. This is
 		// merely a syntactic check; it does not check whether the token is
 		// meaningful.
-		static bool is_token(std::string const &s) {
-			if (s.empty())
+		static bool is_token(char const *beg, char const *end) {
+			if (beg == end)
 				return false; // token must have at least one character
-			return std::find_if_not(s.begin(), s.end(), is_token_char) == s.end();
+			return std::find_if_not(beg, end, is_token_char) == end;
+		}
+
+		static bool is_token(std::string const &s) {
+			return is_token(s.data(), s.data() + s.size());
 		}
 
 		static bool status_code_from_int(status_code &stat, int n) {
@@ -76,50 +80,55 @@ namespace clane {
 			return is_token(s);
 		}
 
+		bool is_header_name_valid(char const *beg, char const *end) {
+			return is_token(beg, end);
+		}
+
 		bool is_header_value_valid(std::string const &s) {
-			for (size_t i = 0; i < s.size(); ++i) {
-				if ((0 <= s[i] && s[i] < 32 && s[i] != '\t') || s[i] == 127)
-					return false;
-			}
-			return true;
+			return is_header_value_valid(s.data(), s.data() + s.size());
+		}
+
+		bool is_header_value_valid(char const *beg, char const *end) {
+			return ascii::find_control_char(beg, end) == end;
 		}
 
 		bool is_method_valid(std::string const &s) {
 			return is_token(s);
 		}
 
-		bool parse_version(int *major_ver, int *minor_ver, std::string &s) {
-			if (s.size() < 5 || std::memcmp(s.c_str(), "HTTP/", 5))
-				return false;
-			s.erase(0, 5);
-			std::istringstream pss(s);
-			pss.unsetf(pss.skipws);
-			pss >> *major_ver;
-			if (!pss || pss.get() != '.' || *major_ver < 0)
+		bool is_method_valid(char const *beg, char const *end) {
+			return is_token(beg, end);
+		}
+
+		bool parse_version(int *major_ver, int *minor_ver, std::string const &s) {
+			return parse_version(major_ver, minor_ver, s.data(), s.data() + s.size());
+		}
+
+		bool parse_version(int *major_ver, int *minor_ver, char const *beg, char const *end) {
+			if (end - beg < 5 || std::memcmp(beg, "HTTP/", 5))
 				return false;
-			pss >> *minor_ver;
-			if (!pss || pss.get() != std::istringstream::traits_type::eof() || *minor_ver < 0)
+			char const *const dot = ascii::find_char(beg + 5, end, '.');
+			unsigned major, minor;
+			unsigned const max = std::numeric_limits<int>::max();
+			if (!ascii::parse_decimal(beg + 5, dot, major) || dot == end ||
+			!ascii::parse_decimal(dot + 1, end, minor) || major > max || minor > max)
 				return false;
+			*major_ver = major;
+			*minor_ver = minor;
 			return true;
 		}
 
-		bool parse_status_code(status_code *stat, std::string &s) {
-			std::istringstream pss(s);
-			pss.unsetf(pss.skipws);
-			int pstat;
-			pss >> pstat;
-			if (!pss || pss.get() != std::istringstream::traits_type::eof())
-				return false;
-			if (!status_code_from_int(*stat, pstat))
+		bool parse_status_code(status_code *stat, std::string const &s) {
+			unsigned n;
+			if (!ascii::parse_decimal(s.data(), s.data() + s.size(), n) || n > 999)
 				return false;
-			return true;
+			return status_code_from_int(*stat, n);
 		}
 
 		bool query_headers_chunked(header_map const &hdrs) {
 			// FIXME: Check for other transfer-codings.
 			// FIXME: Check transfer-encoding order.
-			static std::string const key("transfer-encoding");
-			auto r = hdrs.equal_range(key);
+			auto r = hdrs.equal_range(header_id::transfer_encoding);
 			for (auto i = r.first; i != r.second; ++i) {
 				if (i->second == "chunked")
 					return true;
@@ -130,23 +139,17 @@ namespace clane {
 		bool query_headers_content_length(header_map const &hdrs, size_t &olen) {
 			// FIXME: Check for multiple and/or invalid content-length headers. For
 			// now, assume the first content-length header is the only one.
-			static std::string const key("content-length");
-			auto p = hdrs.find(key);
+			auto p = hdrs.find(header_id::content_length);
 			if (p == hdrs.end())
 				return false;
-			std::istringstream ss(p->second);
-			size_t len;
-			ss >> len;
-			if (!ss || !ss.eof())
-				return false;
-			olen = len;
-			return true;
+			return ascii::parse_decimal(p->second.data(), p->second.data() + p->second.size(), olen);
 		}
 
 		void v1x_request_line_incparser::reset() {
 			incparser::reset();
 			cur_stat = state::method;
 			method_.clear();
+			method_id_ = 0;
 			uri_.clear();
 			uri_str.clear();
 			version_str.clear();
@@ -159,7 +162,7 @@ namespace clane {
 			char const *newline = ascii::find_newline(cur, end);
 			switch (cur_stat) {
 				case state::method: {
-					char const *space = std::find(cur, newline, ' ');
+					char const *space = ascii::find_char(cur, newline, ' ');
 					if (newline != end && space == newline) {
 						set_error(status_code::bad_request, "missing request line URI reference");
 						return error;
@@ -176,13 +179,14 @@ namespace clane {
 						set_error(status_code::bad_request, "invalid request line method");
 						return error;
 					}
+					method_id_ = parse_method(method_);
 					cur_stat = state::uri;
 					cur = space + 1;
 					// fall through to next case
 				}
 
 	 			case state::uri: {
-					char const *space = std::find(cur, newline, ' ');
+					char const *space = ascii::find_char(cur, newline, ' ');
 					if (newline != end && space == newline) {
 						set_error(status_code::bad_request, "missing request line HTTP version");
 						return error;
@@ -256,6 +260,30 @@ namespace clane {
 			return cur - beg; // complete and successful
 		}
 
+		size_t v1x_request_line_incparser::parse_whole(char const *beg, char const *end) {
+			char const *const newline = ascii::find_newline(beg, end);
+			char const *eol = newline;
+			if (eol != end && *eol == '\r')
+				++eol;
+			if (eol == end || *eol != '\n' || !increase_length(eol + 1 - beg))
+				return 0;
+			char const *const space1 = ascii::find_char(beg, newline, ' ');
+			char const *const space2 = ascii::find_char(std::min(space1 + 1, newline), newline, ' ');
+			if (space2 == newline || !is_method_valid(beg, space1))
+				return 0;
+			std::error_code e;
+			uri::uri u = uri::parse_uri_reference(space1 + 1, space2, e);
+			if (e)
+				return 0;
+			if (!parse_version(&major_ver, &minor_ver, space2 + 1, newline))
+				return 0;
+			method_.assign(beg, space1);
+			method_id_ = parse_method(method_);
+			uri_ = std::move(u);
+			set_done();
+			return eol + 1 - beg;
+		}
+
 		void v1x_status_line_incparser::reset() {
 			incparser::reset();
 			cur_stat = state::version;
@@ -271,7 +299,7 @@ namespace clane {
 			switch (cur_stat) {
 
 				case state::version: {
-					char const *space = std::find(cur, newline, ' ');
+					char const *space = ascii::find_char(cur, newline, ' ');
 					if (newline != end && space == newline) {
 						set_error(status_code::bad_request, "missing status line status code");
 						return error;
@@ -294,7 +322,7 @@ namespace clane {
 				}
 
 				case state::status: {
-					char const *space = std::find(cur, newline, ' ');
+					char const *space = ascii::find_char(cur, newline, ' ');
 					if (newline != end && space == newline) {
 						set_error(status_code::bad_request, "missing status line reason phrase");
 						return error;
@@ -357,12 +385,84 @@ namespace clane {
 			return cur - beg; // complete and successful
 		}
 
+		v1x_headers_incparser::v1x_headers_incparser(v1x_headers_incparser const &that):
+			incparser(that),
+			cur_stat{that.cur_stat},
+			hdrs(that.hdrs),
+			hdr_name(that.hdr_name),
+			hdr_val(that.hdr_val),
+			view_mode{that.view_mode},
+			views(that.views),
+			pend(that.pend)
+		{
+			copy_views(that);
+		}
+
+		v1x_headers_incparser &v1x_headers_incparser::operator=(v1x_headers_incparser const &that) {
+			if (this == &that)
+				return *this;
+			incparser::operator=(that);
+			cur_stat = that.cur_stat;
+			hdrs = that.hdrs;
+			hdr_name = that.hdr_name;
+			hdr_val = that.hdr_val;
+			view_mode = that.view_mode;
+			views = that.views;
+			pend = that.pend;
+			copy_views(that);
+			return *this;
+		}
+
+		// Copies another parser's owned names and values and points this parser's
+		// views at the copies. Views into the caller's memory stay as they are.
+		void v1x_headers_incparser::copy_views(v1x_headers_incparser const &that) {
+			copies.clear();
+			copies.reserve(that.copies.size());
+			for (auto i = that.copies.begin(); i != that.copies.end(); ++i)
+				copies.push_back(std::unique_ptr<std::string>(new std::string(**i)));
+			auto rebase = [&](char const *p) -> char const * {
+				for (size_t i = 0; i < that.copies.size(); ++i) {
+					std::string const &s = *that.copies[i];
+					if (s.data() <= p && p <= s.data() + s.size())
+						return copies[i]->data() + (p - s.data());
+				}
+				return p;
+			};
+			for (auto i = views.begin(); i != views.end(); ++i) {
+				i->name = rebase(i->name);
+				i->value = rebase(i->value);
+			}
+			pend.name = rebase(pend.name);
+			pend.value = rebase(pend.value);
+		}
+
 		void v1x_headers_incparser::reset() {
 			incparser::reset();
 			cur_stat = state::start_line;
 			hdrs.clear();
 			hdr_name.clear();
 			hdr_val.clear();
+			views.clear();
+			copies.clear();
+			pend = header_view{};
+		}
+
+		// Moves a header name or value that couldn't be a view into storage that
+		// lasts until the next reset. Each copy has its own allocation so that
+		// views into it survive moving the parser.
+		char const *v1x_headers_incparser::keep(std::string &&s) {
+			copies.push_back(std::unique_ptr<std::string>(new std::string(std::move(s))));
+			s.clear();
+			return copies.back()->data();
+		}
+
+		// Replaces the view of the header value in progress with a copy, so that
+		// the value may be extended.
+		void v1x_headers_incparser::spill_value() {
+			if (!pend.value)
+				return;
+			hdr_val.assign(pend.value, pend.value_size);
+			pend.value = nullptr;
 		}
 
 		size_t v1x_headers_incparser::parse_some(char const *beg, char const *end) {
@@ -423,21 +523,32 @@ namespace clane {
 					}
 
 					case state::name: {
-						char const *colon = std::find(cur, newline, ':');
-						hdr_name.append(cur, colon);
+						char const *colon = ascii::find_char(cur, newline, ':');
 						if (colon == newline) {
 							if (newline != end) {
 								set_error(status_code::bad_request, invalid);
 								return error;
 							}
+							hdr_name.append(cur, colon);
 							cur = colon;
 							return cur - beg; // incomplete
 						}
-						ascii::rtrim(hdr_name);
-						if (!is_header_name_valid(hdr_name)) {
+						if (view_mode && hdr_name.empty()) {
+							// The whole name is in this block.
+							pend.name = cur;
+							pend.name_size = ascii::rtrim(cur, colon) - cur;
+						} else {
+							hdr_name.append(cur, colon);
+							ascii::rtrim(hdr_name);
+							pend.name = hdr_name.data();
+							pend.name_size = hdr_name.size();
+						}
+						if (!is_header_name_valid(pend.name, pend.name + pend.name_size)) {
 							set_error(status_code::bad_request, invalid);
 							return error;
 						}
+						if (view_mode && !hdr_name.empty())
+							pend.name = keep(std::move(hdr_name));
 						cur_stat = state::value_skipws;
 						cur = colon + 1;
 						break;
@@ -445,13 +556,21 @@ namespace clane {
 
 					case state::value_skipws: {
 						cur = ascii::skip_whitespace(cur, newline);
-						if (cur != newline)
-							cur_stat = state::value;
+						if (cur != newline || newline != end)
+							cur_stat = state::value; // maybe an empty value
 						break;
 					}
 
 					case state::value: {
-						hdr_val.append(cur, newline);
+						if (view_mode && !pend.value && hdr_val.empty() && newline != end) {
+							// The whole value is in this block--unless a continuation line
+							// follows.
+							pend.value = cur;
+							pend.value_size = newline - cur;
+						} else {
+							spill_value();
+							hdr_val.append(cur, newline);
+						}
 						cur = newline;
 						if (cur == end)
 							return cur - beg; // incomplete
@@ -491,20 +610,30 @@ namespace clane {
 							++nonspace;
 						if (cur != nonspace) {
 							cur = nonspace;
+							spill_value();
 							hdr_val.push_back(' '); // replace all linear whitespace with a single space character
 							cur_stat = state::value_skipws;
 							break;
 						}
-						ascii::rtrim(hdr_val);
-						if (!is_header_value_valid(hdr_val)) {
+						if (pend.value) {
+							pend.value_size = ascii::rtrim(pend.value, pend.value + pend.value_size) - pend.value;
+						} else {
+							ascii::rtrim(hdr_val);
+							pend.value = hdr_val.data();
+							pend.value_size = hdr_val.size();
+						}
+						if (!is_header_value_valid(pend.value, pend.value + pend.value_size)) {
 							set_error(status_code::bad_request, invalid);
 							return error;
 						}
-#ifdef CLANE_HAVE_STD_MULTIMAP_EMPLACE
-						hdrs.emplace(std::move(hdr_name), std::move(hdr_val));
-#else
-						hdrs.insert(header(std::move(hdr_name), std::move(hdr_val)));
-#endif
+						if (view_mode) {
+							if (!hdr_val.empty())
+								pend.value = keep(std::move(hdr_val));
+							views.push_back(pend);
+						} else {
+							hdrs.emplace(std::move(hdr_name), std::move(hdr_val));
+						}
+						pend = header_view{};
 						hdr_name.clear();
 						hdr_val.clear();
 						cur_stat = state::start_line;
@@ -515,6 +644,40 @@ namespace clane {
 			return cur - beg; // incomplete
 		}
 
+		size_t v1x_headers_incparser::parse_whole(char const *beg, char const *end) {
+			if (view_mode)
+				return 0;
+			char const *cur = beg;
+			while (true) {
+				char const *const newline = ascii::find_newline(cur, end);
+				char const *eol = newline;
+				if (eol != end && *eol == '\r')
+					++eol;
+				if (eol == end || *eol != '\n')
+					break;
+				if (newline == cur) {
+					if (!increase_length(eol + 1 - beg))
+						break;
+					set_done();
+					return eol + 1 - beg;
+				}
+				if (*cur == ' ' || *cur == '\t')
+					break; // obsolete line folding
+				char const *const colon = ascii::find_char(cur, newline, ':');
+				if (colon == newline)
+					break;
+				char const *const name_end = ascii::rtrim(cur, colon);
+				char const *const val = ascii::skip_whitespace(colon + 1, newline);
+				char const *const val_end = ascii::rtrim(val, newline);
+				if (!is_header_name_valid(cur, name_end) || !is_header_value_valid(val, val_end))
+					break;
+				hdrs.emplace(std::string(cur, name_end), std::string(val, val_end));
+				cur = eol + 1;
+			}
+			hdrs.clear();
+			return 0;
+		}
+
 		void v1x_chunk_line_incparser::reset() {
 			incparser::reset();
 			cur_stat = state::digit;
@@ -528,10 +691,6 @@ namespace clane {
 			while (cur < end) {
 				switch (cur_stat) {
 					case state::digit:
-						if (nibs == max_nibs) {
-							set_error(status_code::bad_request, "chunk size overflow");
-							return error;
-						}
 						if ('\r' == *cur || '\n' == *cur) {
 							if (!nibs) {
 								set_error(status_code::bad_request, "missing chunk size");
@@ -549,8 +708,10 @@ namespace clane {
 							set_error(status_code::bad_request, invalid);
 							return error;
 						}
-						chunk_size_ <<= 4;
-						chunk_size_ |= ascii::hexch_to_int(*cur);
+						if (!ascii::append_digit(chunk_size_, 16, ascii::hexch_to_int(*cur))) {
+							set_error(status_code::bad_request, "chunk size overflow");
+							return error;
+						}
 						++nibs;
 						break;
 					case state::newline:
@@ -671,28 +832,67 @@ namespace clane {
 			got_hdrs = false;
 		}
 
+		// Returns the end of the first empty line in a memory block, or null if
+		// there's none.
+		static char const *find_head_end(char const *beg, char const *end) {
+			for (char const *p = beg; (p = ascii::find_char(p, end, '\n')) != end; ++p) {
+				if (end - p > 1 && p[1] == '\n')
+					return p + 2;
+				if (end - p > 2 && p[1] == '\r' && p[2] == '\n')
+					return p + 3;
+			}
+			return nullptr;
+		}
+
+		size_t v1x_request_incparser::parse_head(char const *beg, char const *end) {
+			char const *const head_end = find_head_end(beg, end);
+			if (!head_end)
+				return 0;
+			size_t const line = v1x_request_line_incparser::parse_whole(beg, head_end);
+			if (line) {
+				v1x_headers_incparser::reset();
+				size_t const block = v1x_headers_incparser::parse_whole(beg + line, head_end);
+				if (block)
+					return line + block;
+			}
+			v1x_request_line_incparser::reset();
+			return 0;
+		}
+
 		size_t v1x_request_incparser::parse_some(char const *beg, char const *end) {
 			char const *cur = beg;
 			switch (cur_stat) {
 				case state::request_line: {
-					size_t stat = v1x_request_line_incparser::parse_some(cur, end);
-					if (error == stat)
-						return error;
-					cur += stat;
-					if (*this)
-						return cur - beg; // incomplete
+					// Most requests arrive whole, so first try parsing the request head
+					// in one pass. Anything unusual, such as a head split across blocks,
+					// an error, or obsolete line folding, goes through the incremental
+					// parsers instead.
+					size_t stat = method().empty() ? parse_head(cur, end) : 0;
+					if (stat) {
+						cur += stat;
+					} else {
+						stat = v1x_request_line_incparser::parse_some(cur, end);
+						if (error == stat)
+							return error;
+						cur += stat;
+						if (*this)
+							return cur - beg; // incomplete
+						v1x_headers_incparser::reset();
+					}
 					cur_stat = state::headers;
-					v1x_headers_incparser::reset();
 					// fall through to next case
 				}
 
 				case state::headers: {
-					size_t stat = v1x_headers_incparser::parse_some(cur, end);
-					if (error == stat)
-						return error;
-					cur += stat;
-					if (*this)
-						return cur - beg; // incomplete
+					// The headers are already done if the head was parsed in one pass.
+					if (*this) {
+						size_t stat = v1x_headers_incparser::parse_some(cur, end);
+						if (error == stat)
+							return error;
+						cur += stat;
+						if (*this)
+							return cur - beg; // incomplete
+					}
 					got_hdrs = true;
 					hdrs = std::move(v1x_headers_incparser::headers());
 					cur_stat = state::body;
@@ -16,11 +16,15 @@ namespace clane {
 	namespace http {
 
 		bool is_header_name_valid(std::string const &s);
+		bool is_header_name_valid(char const *beg, char const *end);
 		bool is_header_value_valid(std::string const &s);
+		bool is_header_value_valid(char const *beg, char const *end);
 		bool is_method_valid(std::string const &s);
+		bool is_method_valid(char const *beg, char const *end);
 
-		bool parse_version(int *major_ver, int *minor_ver, std::string &s);
-		bool parse_status_code(status_code *stat, std::string &s);
+		bool parse_version(int *major_ver, int *minor_ver, std::string const &s);
+		bool parse_version(int *major_ver, int *minor_ver, char const *beg, char const *end);
+		bool parse_status_code(status_code *stat, std::string const &s);
 
 		bool query_headers_chunked(header_map const &hdrs);
 		bool query_headers_content_length(header_map const &hdrs, size_t &len_o);
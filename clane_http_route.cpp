@@ -6,12 +6,395 @@
 
 /** @file */
 
+#include "clane_ascii.hpp"
 #include "clane_http_route.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <thread>
 
 namespace clane {
 	namespace http {
 
-		// FIXME: Remove this translation unit?
+		// Returns true if a Perl-syntax escape of the given character matches the
+		// character itself. Escaped punctuation is literal except for the
+		// assertions "\<", "\>", "\`", and "\'".
+		static bool is_literal_escape(char c) {
+			return std::ispunct(static_cast<unsigned char>(c)) && !std::strchr("<>`'", c);
+		}
+
+		route_literal analyze_route_pattern(std::string const &pattern, regex::options_type reopts) {
+			if (regex::options::literal == reopts)
+				return route_literal{route_literal::substring, pattern};
+			if (pattern.empty())
+				return route_literal{route_literal::prefix, std::string()}; // matches everything
+			route_literal const none{route_literal::none, std::string()};
+			if ('^' != pattern[0])
+				return none;
+			std::string text;
+			for (size_t i = 1; i < pattern.size(); ++i) {
+				char const c = pattern[i];
+				if ('\\' == c) {
+					// An escaped punctuation character is literal; other escapes, e.g.,
+					// "\d" and "\<", are character classes or assertions.
+					if (i + 1 == pattern.size() || !is_literal_escape(pattern[i+1]))
+						return none;
+					text += pattern[++i];
+				} else if ('$' == c && i + 1 == pattern.size()) {
+					return route_literal{route_literal::exact, std::move(text)};
+				} else if (!c || std::strchr(".[]{}()*+?|^$", c)) {
+					return none;
+				} else {
+					text += c;
+				}
+			}
+			return route_literal{route_literal::prefix, std::move(text)};
+		}
+
+		bool is_route_literal_safe(std::string const &s) {
+			for (auto i = s.begin(); i != s.end(); ++i) {
+				unsigned char const c = *i;
+				if (c < 0x20 || c >= 0x7f)
+					return false;
+			}
+			return true;
+		}
+
+		bool parse_route_path_template(std::string const &pattern, route_path_template *t) {
+			t->names.clear();
+			t->texts.assign(1, std::string());
+			t->literal = !pattern.empty() && '^' == pattern[0];
+			t->regex = t->literal ? "^" : "";
+			t->exact = false;
+			bool in_class = false;
+			for (size_t i = t->literal ? 1 : 0; i < pattern.size(); ++i) {
+				char const c = pattern[i];
+
+				// parameter?
+				if ('{' == c && !in_class && i + 1 < pattern.size() &&
+					(std::isalpha(static_cast<unsigned char>(pattern[i+1])) || '_' == pattern[i+1])) {
+					size_t end = i + 2;
+					while (end < pattern.size() && (std::isalnum(static_cast<unsigned char>(pattern[end])) ||
+						'_' == pattern[end]))
+						++end;
+					if (end < pattern.size() && '}' == pattern[end]) {
+						std::string name = pattern.substr(i + 1, end - i - 1);
+						t->regex += "(?<" + name + ">[^/]+)";
+						t->names.push_back(std::move(name));
+						t->texts.push_back(std::string());
+						i = end;
+						// The literal form finds the end of the parameter by searching
+						// for the next '/'.
+						if (end + 1 < pattern.size() && '/' != pattern[end+1] &&
+							!('$' == pattern[end+1] && end + 2 == pattern.size()))
+							t->literal = false;
+						continue;
+					}
+				}
+
+				t->regex += c;
+				if ('\\' == c) {
+					if (i + 1 < pattern.size())
+						t->regex += pattern[i+1];
+					if (i + 1 == pattern.size() || !is_literal_escape(pattern[i+1]))
+						t->literal = false;
+					else
+						t->texts.back() += pattern[i+1];
+					++i;
+				} else if (in_class) {
+					if (']' == c)
+						in_class = false;
+				} else if ('[' == c) {
+					in_class = true;
+					t->literal = false;
+				} else if ('$' == c && i + 1 == pattern.size()) {
+					t->exact = true;
+				} else if (!c || std::strchr(".[]{}()*+?|^$", c)) {
+					t->literal = false;
+				} else {
+					t->texts.back() += c;
+				}
+			}
+			if (!t->literal)
+				t->texts.clear();
+			return !t->names.empty();
+		}
+
+		static bool match_route_path_template(std::string const &path, route_path_template const &t,
+			std::vector<path_param> *params) {
+			size_t pos = 0;
+			for (size_t i = 0; i < t.names.size(); ++i) {
+				if (path.compare(pos, t.texts[i].size(), t.texts[i]))
+					return false;
+				pos += t.texts[i].size();
+				size_t end = std::min(path.find('/', pos), path.size());
+				if (end == pos)
+					return false; // empty segment
+				if (params)
+					params->push_back(path_param{t.names[i], path.data() + pos, end - pos});
+				pos = end;
+			}
+			if (path.compare(pos, t.texts.back().size(), t.texts.back()))
+				return false;
+			return !t.exact || pos + t.texts.back().size() == path.size();
+		}
+
+		bool match_route_path(std::string const &path, boost::regex const &re, route_literal const &lit,
+			route_path_template const &t, std::vector<path_param> *params) {
+			if (t.names.empty())
+				return match_route_criterion(path, re, lit);
+			if (t.literal && is_route_literal_safe(path))
+				return match_route_path_template(path, t, params);
+			boost::smatch m;
+			if (!boost::regex_search(path, m, re))
+				return false;
+			if (params) {
+				for (auto i = t.names.begin(); i != t.names.end(); ++i) {
+					auto const &sub = m[*i];
+					params->push_back(path_param{*i, path.data() + (sub.first - path.begin()),
+						static_cast<size_t>(sub.length())});
+				}
+			}
+			return true;
+		}
+
+		method_set analyze_method_pattern(std::string const &pattern, regex::options_type reopts, bool *exact) {
+			*exact = false;
+			if (pattern.empty()) {
+				*exact = true;
+				return method_any;
+			}
+			if (regex::options::literal == reopts || pattern.size() < 3 || '^' != pattern[0] ||
+				'$' != pattern[pattern.size()-1])
+				return method_any;
+
+			// Strip the anchors and any enclosing group, and split the
+			// alternatives. Without a group, the anchors bind to the first and last
+			// alternatives only--e.g., "^GET|POST$" matches "GETX"--so only a
+			// single method may go ungrouped.
+			std::string alts = pattern.substr(1, pattern.size() - 2);
+			if (!alts.compare(0, 3, "(?:") && ')' == alts[alts.size()-1])
+				alts = alts.substr(3, alts.size() - 4);
+			else if ('(' == alts[0] && ')' == alts[alts.size()-1])
+				alts = alts.substr(1, alts.size() - 2);
+			else if (std::string::npos != alts.find('|'))
+				return method_any;
+			method_set methods = 0;
+			bool all_standard = true;
+			size_t beg = 0;
+			while (true) {
+				size_t const end = std::min(alts.find('|', beg), alts.size());
+				std::string const name = alts.substr(beg, end - beg);
+				if (name.empty() || std::string::npos != name.find_first_of(".[]{}()*+?^$\\"))
+					return method_any;
+				method_set const m = parse_method(name);
+				if (method_other == m)
+					all_standard = false;
+				methods |= m;
+				if (end == alts.size())
+					break;
+				beg = end + 1;
+			}
+			*exact = all_standard;
+			return methods;
+		}
+
+		route_match_cache::route_match_cache(size_t capacity) {
+			size_t const slots = (capacity + shard_count - 1) / shard_count;
+			for (size_t i = 0; i < shard_count; ++i) {
+				shards[i].slots.resize(slots);
+				shards[i].hits = 0;
+				shards[i].misses = 0;
+			}
+		}
+
+		route_match_cache::shard &route_match_cache::locate(std::string const &method, std::string const &host,
+			std::string const &path, slot **sl) {
+			std::hash<std::string> hash;
+			size_t const h = (hash(path) * 31 + hash(host)) * 31 + hash(method);
+			shard &sh = shards[h % shard_count];
+			*sl = &sh.slots[h / shard_count % sh.slots.size()];
+			return sh;
+		}
+
+		bool route_match_cache::find(std::string const &method, std::string const &host, std::string const &path,
+			size_t *route, std::vector<path_param> *params) {
+			slot *sl;
+			shard &sh = locate(method, host, path, &sl);
+			std::lock_guard<std::mutex> lock(sh.mutex);
+			if (!sl->used || sl->path != path || sl->host != host || sl->method != method) {
+				++sh.misses;
+				return false;
+			}
+			++sh.hits;
+			*route = sl->route;
+			for (auto i = sl->params.begin(); i != sl->params.end(); ++i)
+				params->push_back(path_param{i->name, path.data() + i->pos, i->size});
+			return true;
+		}
+
+		void route_match_cache::insert(std::string const &method, std::string const &host, std::string const &path,
+			size_t route, std::vector<path_param> const &params, size_t first_param) {
+			slot *sl;
+			shard &sh = locate(method, host, path, &sl);
+			std::lock_guard<std::mutex> lock(sh.mutex);
+			sl->used = true;
+			sl->method = method;
+			sl->host = host;
+			sl->path = path;
+			sl->route = route;
+			sl->params.clear();
+			for (size_t i = first_param; i < params.size(); ++i)
+				sl->params.push_back(cached_param{params[i].name, static_cast<size_t>(params[i].data - path.data()),
+					params[i].size});
+		}
+
+		void route_match_cache::clear() {
+			for (size_t i = 0; i < shard_count; ++i) {
+				std::lock_guard<std::mutex> lock(shards[i].mutex);
+				for (auto j = shards[i].slots.begin(); j != shards[i].slots.end(); ++j)
+					j->used = false;
+			}
+		}
+
+		size_t route_match_cache::hits() {
+			size_t n = 0;
+			for (size_t i = 0; i < shard_count; ++i) {
+				std::lock_guard<std::mutex> lock(shards[i].mutex);
+				n += shards[i].hits;
+			}
+			return n;
+		}
+
+		size_t route_match_cache::misses() {
+			size_t n = 0;
+			for (size_t i = 0; i < shard_count; ++i) {
+				std::lock_guard<std::mutex> lock(shards[i].mutex);
+				n += shards[i].misses;
+			}
+			return n;
+		}
+
+		std::string normalize_host(std::string const &host) {
+			std::string s = host;
+			ascii::rtrim(s);
+			size_t end;
+			if (!s.empty() && '[' == s[0]) {
+				// IP literal, e.g., "[::1]:8080"
+				end = s.find(']');
+				end = std::string::npos == end ? s.size() : end + 1;
+			} else {
+				end = s.find(':');
+				if (std::string::npos == end || std::string::npos != s.find(':', end + 1))
+					end = s.size(); // no port, or not a valid host--leave it
+				while (end && '.' == s[end-1])
+					--end;
+			}
+			s.erase(end);
+			for (auto i = s.begin(); i != s.end(); ++i)
+				*i = std::tolower(static_cast<unsigned char>(*i));
+			return s;
+		}
+
+		reader_window::reader_window(): parity(0) {
+			counts[0] = 0;
+			counts[1] = 0;
+		}
+
+		void reader_window::synchronize() {
+			for (int i = 0; i < 2; ++i) {
+				unsigned const ticket = parity.fetch_xor(1) & 1;
+				while (counts[ticket].load())
+					std::this_thread::yield();
+			}
+		}
+
+		void route_index::add(size_t route, method_set methods, route_literal const &path) {
+			for (size_t i = 0; i < method_count; ++i) {
+				if (methods & (1u << i))
+					add(by_method[i], route, path);
+			}
+		}
+
+		void route_index::add(tree &t, size_t route, route_literal const &path) {
+			if (route_literal::prefix != path.kind && route_literal::exact != path.kind) {
+				t.other_routes.push_back(route);
+				return;
+			}
+
+			// Walk the tree, splitting an edge where the path diverges from it.
+			node *n = &t.root;
+			size_t pos = 0;
+			while (pos < path.text.size()) {
+				char const c = path.text[pos];
+				auto child = std::lower_bound(n->children.begin(), n->children.end(), c,
+					[](std::unique_ptr<node> const &a, char ch) { return a->label[0] < ch; });
+				if (child == n->children.end() || (*child)->label[0] != c) {
+					std::unique_ptr<node> leaf(new node);
+					leaf->label = path.text.substr(pos);
+					child = n->children.insert(child, std::move(leaf));
+					n = child->get();
+					break;
+				}
+				node *const next = child->get();
+				size_t const max_len = std::min(next->label.size(), path.text.size() - pos);
+				size_t len = 1;
+				while (len < max_len && next->label[len] == path.text[pos + len])
+					++len;
+				if (len < next->label.size()) {
+					std::unique_ptr<node> mid(new node);
+					mid->label = next->label.substr(0, len);
+					next->label.erase(0, len);
+					mid->children.push_back(std::move(*child));
+					*child = std::move(mid);
+				}
+				n = child->get();
+				pos += len;
+			}
+			(route_literal::prefix == path.kind ? n->prefix_routes : n->exact_routes).push_back(route);
+		}
+
+		void route_index::finish() {
+			for (size_t i = 0; i < method_count; ++i)
+				finish(by_method[i].root, by_method[i].other_routes);
+		}
+
+		void route_index::finish(node &n, std::vector<size_t> const &inherited) {
+			n.passing.clear();
+			std::merge(inherited.begin(), inherited.end(), n.prefix_routes.begin(), n.prefix_routes.end(),
+				std::back_inserter(n.passing));
+			n.ending.clear();
+			std::merge(n.passing.begin(), n.passing.end(), n.exact_routes.begin(), n.exact_routes.end(),
+				std::back_inserter(n.ending));
+			for (auto i = n.children.begin(); i != n.children.end(); ++i)
+				finish(**i, n.passing);
+		}
+
+		std::vector<size_t> const *route_index::find(method_set method_id, std::string const &path) const {
+			if (!is_route_literal_safe(path))
+				return nullptr; // every route must be tried
+			size_t m = 0;
+			while (m < method_count && !(method_id & (1u << m)))
+				++m;
+			if (m == method_count)
+				return nullptr;
+			node const *n = &by_method[m].root;
+			size_t pos = 0;
+			while (pos < path.size()) {
+				char const c = path[pos];
+				auto child = std::lower_bound(n->children.begin(), n->children.end(), c,
+					[](std::unique_ptr<node> const &a, char ch) { return a->label[0] < ch; });
+				if (child == n->children.end() || (*child)->label[0] != c ||
+					path.compare(pos, (*child)->label.size(), (*child)->label))
+					return &n->passing;
+				n = child->get();
+				pos += n->label.size();
+			}
+			return &n->ending;
+		}
+
 	}
 }
 
@@ -10,6 +10,7 @@
 #include "clane_http_server.hpp"
 #include "clane_net_inet.hpp"
 #include "clane_net_poller.hpp"
+#include <cstdio>
 
 namespace clane {
 	namespace http {
@@ -17,25 +18,18 @@ namespace clane {
 		// FIXME: What to do with default_error_handler? Remove?
 		void default_error_handler(response_ostream &rs, request &req, status_code stat, std::string const &msg) {
 			rs.status = stat;
-#ifdef CLANE_HAVE_STD_MULTIMAP_EMPLACE
 			rs.headers.emplace("content-type", "text/plain");
-#else
-			rs.headers.insert(header("content-type", "text/plain"));
-#endif
 			rs << static_cast<int>(stat) << ' ' << what(stat) << '\n';
 			if (!msg.empty())
 				rs << msg << '\n';
 		}
 
-		server_streambuf::~server_streambuf() {
-			if (enabled)
-				flush(true);
-		}
+		server_streambuf::~server_streambuf() {}
 
-		server_streambuf::server_streambuf(net::socket &sock): sock(sock), major_ver{}, minor_ver{},
-		 	out_stat_code(status_code::ok), in_end{}, enabled{}, active{true}, hdrs_written{}, chunked{} {
+		server_streambuf::server_streambuf(server_connection &conn, size_t seq): conn(conn), seq{seq}, major_ver{},
+			minor_ver{}, out_stat_code(status_code::ok), in_end{}, enabled{}, may_block{true}, hdrs_written{}, chunked{} {
 			in_queue.push_back(buffer{}); // dummy node
-			setp(out_buf, out_buf); // force overflow on first write
+			setp(out_buf, out_buf+sizeof(out_buf));
 		}
 
 		void server_streambuf::more_request_body(std::shared_ptr<char> const &p, size_t offset, size_t size) {
@@ -61,77 +55,144 @@ namespace clane {
 				in_cond.notify_one();
 		}
 
-		void server_streambuf::inactivate() {
-			std::lock_guard<std::mutex> out_lock(act_mutex);
-			active = false;
+		bool server_streambuf::send_file(std::shared_ptr<posix::unique_fd> const &fd, off_t offset, size_t size) {
+			// Send the headers and anything already buffered first.
+			if (-1 == flush())
+				return false;
+			std::error_code e;
+			char chunk_line[2*sizeof(size_t)+3];
+			if (chunked && size) {
+				iovec iov{chunk_line, static_cast<size_t>(std::snprintf(chunk_line, sizeof(chunk_line), "%zx\r\n", size))};
+				conn.send(seq, &iov, 1, may_block, e);
+				if (e)
+					return false;
+			}
+			conn.send_file(seq, fd, offset, size, may_block, e);
+			if (e)
+				return false;
+			if (chunked && size) {
+				iovec iov{const_cast<char *>("\r\n"), 2};
+				conn.send(seq, &iov, 1, may_block, e);
+				if (e)
+					return false;
+			}
+			return true;
 		}
 
-		void server_streambuf::activate() {
-			std::lock_guard<std::mutex> out_lock(act_mutex);
-			active = true;
-			act_cond.notify_one();
+		void server_streambuf::finish() {
+			if (enabled) {
+				flush(true);
+				enabled = false;
+			}
+			conn.end_response(seq);
 		}
 
-		int server_streambuf::flush(bool end) {
-			std::error_code e;
-			// wait for previous responses in the pipeline to complete:
-			{
-				std::unique_lock<std::mutex> out_lock(act_mutex);
-				while (!active)
-					act_cond.wait(out_lock);
+		void server_streambuf::reject(status_code stat) {
+			// The event loop mustn't block, so send the rejection only if no earlier
+			// response on the connection is still in progress.
+			if (enabled && conn.is_turn(seq)) {
+				out_stat_code = stat;
+				out_hdrs.insert(header("connection", "close"));
+				out_hdrs.insert(header("content-length", "0"));
+				may_block = false;
+				flush(true);
 			}
-			// flush headers if not already written:
+			enabled = false;
+			conn.end_response(seq);
+		}
+
+		int server_streambuf::flush(bool end) {
+
+			// Gather the header block, chunk framing, and payload so that they go
+			// out together in one send. The connection orders sends after those of
+			// previous responses in the pipeline.
+			iovec iov[5];
+			size_t iov_cnt = 0;
+			auto add = [&](char const *p, size_t n) {
+				iov[iov_cnt].iov_base = const_cast<char *>(p);
+				iov[iov_cnt].iov_len = n;
+				++iov_cnt;
+			};
+
+			// headers, if not already written:
+			std::string hdr_lines;
 			if (!hdrs_written) {
 				size_t content_len;
 				if (!query_headers_content_length(out_hdrs, content_len)) {
-					chunked = true;
-#ifdef CLANE_HAVE_STD_MULTIMAP_EMPLACE
-					out_hdrs.emplace("transfer-encoding", "chunked");
-#else
-					out_hdrs.insert(header("transfer-encoding", "chunked"));
-#endif
+					if (end) {
+						// The whole body is in the output buffer, so send it with a
+						// content length instead of chunking it. Responses with these
+						// statuses have no body.
+						int stat = static_cast<int>(out_stat_code);
+						if (stat >= 200 && stat != 204 && stat != 304) {
+							out_hdrs.emplace("content-length", std::to_string(pptr() - pbase()));
+						}
+					} else {
+						chunked = true;
+						out_hdrs.emplace("transfer-encoding", "chunked");
+					}
 				}
-				std::ostringstream ss;
-				ss << "HTTP/" << major_ver << '.' << minor_ver << ' ' << static_cast<int>(out_stat_code) << ' ' <<
-				 	what(out_stat_code) << "\r\n";
-				for (auto i = out_hdrs.begin(); i != out_hdrs.end(); ++i)
-					ss << canonize_1x_header_name(i->first) << ": " << i->second << "\r\n";
-				ss << "\r\n";
-				std::string hdr_lines = ss.str();
-				sock.send(hdr_lines.data(), hdr_lines.size(), net::all, e);
-				if (e)
-					return -1; // connection error
-				hdrs_written = true;
+				hdr_lines = render_headers() + "\r\n";
+				add(hdr_lines.data(), hdr_lines.size());
 			}
-			// send:
+
+			// payload:
+			char chunk_line[2*sizeof(size_t)+3];
 			size_t chunk_len = pptr() - pbase();
 			if (chunk_len) {
-				if (chunked) {
-					std::ostringstream ss;
-					ss << std::hex << chunk_len << "\r\n";
-					std::string chunk_line = ss.str();
-					sock.send(chunk_line.data(), chunk_line.size(), net::all, e);
-					if (e)
-						return -1; // connection error
-				}
-				sock.send(pbase(), chunk_len, net::all, e);
-				if (e)
-					return -1; // connection error
-				if (chunked) {
-					sock.send("\r\n", 2, net::all, e);
-					if (e)
-						return -1; // connection error
-				}
+				if (chunked)
+					add(chunk_line, std::snprintf(chunk_line, sizeof(chunk_line), "%zx\r\n", chunk_len));
+				add(pbase(), chunk_len);
+				if (chunked)
+					add("\r\n", 2);
 			}
+
 			// final chunk:
-			if (end && chunked) {
-				sock.send("0\r\n\r\n", 5, net::all, e);
-				if (e)
-					return -1; // connection error
-			}
+			if (end && chunked)
+				add("0\r\n\r\n", 5);
+
+			if (!iov_cnt)
+				return 0; // nothing to send
+			std::error_code e;
+			conn.send(seq, iov, iov_cnt, may_block, e);
+			if (e)
+				return -1; // connection error
+			hdrs_written = true;
+			setp(out_buf, out_buf+sizeof(out_buf));
 			return 0; // success
 		}
 
+		std::string server_streambuf::render_headers() const {
+			std::string s = "HTTP/" + std::to_string(major_ver) + '.' + std::to_string(minor_ver) + ' ' +
+				std::to_string(static_cast<int>(out_stat_code)) + ' ' + what(out_stat_code) + "\r\n";
+			for (auto i = out_hdrs.begin(); i != out_hdrs.end(); ++i) {
+				append_1x_header_name(s, out_hdrs.id(i), i->first);
+				s.append(": ");
+				s.append(i->second);
+				s.append("\r\n");
+			}
+			return s;
+		}
+
+		// Sends the whole response at once, with the caller's pre-rendered header
+		// lines following the status line and the application's headers. Sends
+		// nothing and returns false if the response has already begun.
+		bool server_streambuf::send_prepared(std::string const &hdr_lines, char const *body, size_t size) {
+			if (!enabled || hdrs_written || pptr() != pbase())
+				return false; // response has already begun
+			std::string const head = render_headers();
+			iovec iov[4] = {
+				{const_cast<char *>(head.data()), head.size()},
+				{const_cast<char *>(hdr_lines.data()), hdr_lines.size()},
+				{const_cast<char *>("\r\n"), 2},
+				{const_cast<char *>(body), size}
+			};
+			hdrs_written = true;
+			std::error_code e;
+			conn.send(seq, iov, 4, may_block, e);
+			return !e;
+		}
+
 		int server_streambuf::sync() {
 			return flush();
 		}
@@ -151,7 +212,6 @@ namespace clane {
 		server_streambuf::int_type server_streambuf::overflow(int_type ch) {
 			if (-1 == flush())
 				return traits_type::eof();
-			setp(out_buf, out_buf+sizeof(out_buf));
 			if (traits_type::eof() != ch) {
 				*out_buf = traits_type::to_char_type(ch);
 				pbump(1);
@@ -159,19 +219,194 @@ namespace clane {
 			return !traits_type::eof();
 		}
 
-		server_context::~server_context() {
-			std::lock_guard<std::mutex> next_lock(next_mutex);
-			// Invariant: This context is active.
-			if (next_ctx)
-				next_ctx->sb.activate();
+		void server_retire_queue::push(server_connection *conn) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (conns.empty())
+				event.signal();
+			conns.push_back(conn);
 		}
 
-		void server_context::set_next_context(std::shared_ptr<server_context> const &nc) {
+		std::vector<server_connection *> server_retire_queue::take() {
+			std::vector<server_connection *> x;
+			std::lock_guard<std::mutex> lock(mutex);
+			x.swap(conns);
+			return x;
+		}
+
+		size_t server_connection::begin_response() {
+			std::lock_guard<std::mutex> out_lock(out_mutex);
+			return ctx_count++;
+		}
+
+		bool server_connection::wait_to_send(std::unique_lock<std::mutex> &out_lock, size_t seq, bool block,
+		std::error_code &e) {
+			// wait for previous responses to finish and for the output queue to have room:
+			while (block && !out_error && (done_count != seq || out_size >= out_limit))
+				out_cond.wait(out_lock);
+			if (out_error) {
+				e = out_error;
+				return false;
+			}
+			return true;
+		}
+
+		void server_connection::send(size_t seq, iovec const *iov, size_t cnt, bool block, std::error_code &e) {
+			std::unique_lock<std::mutex> out_lock(out_mutex);
+			if (!wait_to_send(out_lock, seq, block, e))
+				return;
+			size_t sent = 0;
+			if (out_queue.empty()) {
+				// Nothing is ahead of this data, so try sending it right away. A
+				// partial send means the socket buffer is full.
+				sent = sock.sendv(iov, cnt, e);
+				if (e == std::errc::operation_would_block || e == std::errc::resource_unavailable_try_again) {
+					e.clear();
+				} else if (e) {
+					fail(e);
+					return; // connection error
+				}
+			}
+			// queue the remainder for the event loop to send once the socket is
+			// writable:
+			std::string rest;
+			for (size_t i = 0; i < cnt; ++i) {
+				char const *p = reinterpret_cast<char const *>(iov[i].iov_base);
+				size_t n = iov[i].iov_len;
+				if (sent >= n) {
+					sent -= n;
+					continue;
+				}
+				rest.append(p+sent, n-sent);
+				sent = 0;
+			}
+			if (!rest.empty()) {
+				out_size += rest.size();
+				out_queue.push_back(out_item{std::move(rest), nullptr, 0, 0});
+			}
+		}
+
+		void server_connection::send_file(size_t seq, std::shared_ptr<posix::unique_fd> const &fd, off_t offset,
+		size_t size, bool block, std::error_code &e) {
+			std::unique_lock<std::mutex> out_lock(out_mutex);
+			if (!wait_to_send(out_lock, seq, block, e))
+				return;
+			if (out_queue.empty()) {
+				while (size) {
+					size_t xstat = sock.sendfile(*fd, offset, size, e);
+					size -= xstat;
+					if (e)
+						break;
+					if (!xstat) {
+						e = std::make_error_code(std::errc::io_error); // file is shorter than expected
+						break;
+					}
+				}
+				if (e == std::errc::operation_would_block || e == std::errc::resource_unavailable_try_again) {
+					e.clear();
+				} else if (e) {
+					fail(e);
+					return; // connection or file error
+				}
+			}
+			if (size)
+				out_queue.push_back(out_item{std::string(), fd, offset, size});
+		}
+
+		void server_connection::end_response(size_t seq) {
+			std::lock_guard<std::mutex> out_lock(out_mutex);
+			done_count = seq + 1;
+			out_cond.notify_all();
+			// Wake the event loop if the connection has no more work to do. Do this
+			// while locked so that the event loop can't close the connection, and
+			// destroy its retire queue, first.
+			if (can_retire())
+				retire_queue->push(this);
+		}
+
+		bool server_connection::is_turn(size_t seq) {
+			std::lock_guard<std::mutex> out_lock(out_mutex);
+			return done_count == seq;
+		}
+
+		void server_connection::drain() {
+			std::lock_guard<std::mutex> out_lock(out_mutex);
+			static size_t const max_iov = 16;
+			while (!out_queue.empty()) {
+				std::error_code e;
+
+				// file segment:
+				if (out_queue.front().file) {
+					out_item &item = out_queue.front();
+					size_t xstat = sock.sendfile(*item.file, item.file_offset, item.file_size, e);
+					item.file_size -= xstat;
+					if (!e && !xstat)
+						e = std::make_error_code(std::errc::io_error); // file is shorter than expected
+					if (e == std::errc::operation_would_block || e == std::errc::resource_unavailable_try_again)
+						break; // go back to waiting
+					if (e) {
+						fail(e);
+						break;
+					}
+					if (!item.file_size)
+						out_queue.erase(out_queue.begin());
+					continue;
+				}
+
+				// data, up to the next file segment:
+				iovec iov[max_iov];
+				size_t cnt = 0;
+				for (; cnt < max_iov && cnt < out_queue.size() && !out_queue[cnt].file; ++cnt) {
+					size_t off = cnt ? 0 : out_offset;
+					iov[cnt].iov_base = const_cast<char *>(out_queue[cnt].data.data()) + off;
+					iov[cnt].iov_len = out_queue[cnt].data.size() - off;
+				}
+				size_t xstat = sock.sendv(iov, cnt, e);
+				if (e == std::errc::operation_would_block || e == std::errc::resource_unavailable_try_again)
+					break; // go back to waiting
+				if (e) {
+					fail(e);
+					break;
+				}
+				out_size -= xstat;
+				xstat += out_offset;
+				size_t done = 0;
+				while (done < cnt && xstat >= out_queue[done].data.size())
+					xstat -= out_queue[done++].data.size();
+				out_queue.erase(out_queue.begin(), out_queue.begin() + done);
+				out_offset = xstat;
+			}
+			out_cond.notify_all();
+		}
+
+		void server_connection::fail(std::error_code const &e) {
+			out_error = e;
+			out_queue.clear();
+			out_offset = 0;
+			out_size = 0;
+			out_cond.notify_all();
+		}
+
+		void server_connection::stop_reading() {
 			{
-				std::lock_guard<std::mutex> next_lock(next_mutex);
-				next_ctx = nc;
+				std::lock_guard<std::mutex> out_lock(out_mutex);
+				reading = false;
 			}
-			nc->sb.inactivate();
+			// Unblock any request handler still waiting on request body data, and
+			// drop any partially received request.
+			if (cur_ctx) {
+				cur_ctx->sb.end_request_body();
+				cur_ctx.reset();
+			}
+			pars.reset();
+		}
+
+		bool server_connection::retirable() {
+			std::lock_guard<std::mutex> out_lock(out_mutex);
+			return can_retire();
+		}
+
+		bool server_connection::can_retire() const {
+			return !reading && done_count == ctx_count && (out_queue.empty() || out_error);
 		}
 
 	}
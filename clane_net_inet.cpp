@@ -14,6 +14,7 @@
 #include <netdb.h>
 #include <netinet/ip.h>
 #include <sstream>
+#include <sys/sendfile.h>
 #include <unistd.h>
 
 namespace clane {
@@ -115,18 +116,28 @@ namespace clane {
 			return sd.n;
 		}
 
-		socket pf_tcp_new_listener(int domain, std::string &addr, int backlog) {
+		socket pf_tcp_new_listener(int domain, std::string &addr, int backlog, int flags) {
 			auto lookup = resolve_inet_address(domain, SOCK_STREAM, true, addr);
 			auto sock_fd = sys_socket(lookup->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
 			sys_setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, 1);
+			if (flags & reuse_port)
+				sys_setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, 1);
 			sys_bind(sock_fd, lookup->ai_addr, lookup->ai_addrlen);
 			sys_listen(sock_fd, backlog < 0 ? 256 : backlog);
 			return socket(tcp_protocol_family_by_domain(lookup->ai_family), std::move(sock_fd));
 		}
 
-		socket pf_tcpx_new_listener(std::string &addr, int backlog) { return pf_tcp_new_listener(AF_UNSPEC, addr, backlog); }
-		socket pf_tcp4_new_listener(std::string &addr, int backlog) { return pf_tcp_new_listener(AF_INET, addr, backlog); }
-		socket pf_tcp6_new_listener(std::string &addr, int backlog) { return pf_tcp_new_listener(AF_INET6, addr, backlog); }
+		socket pf_tcpx_new_listener(std::string &addr, int backlog, int flags) {
+		 	return pf_tcp_new_listener(AF_UNSPEC, addr, backlog, flags);
+	 	}
+
+		socket pf_tcp4_new_listener(std::string &addr, int backlog, int flags) {
+		 	return pf_tcp_new_listener(AF_INET, addr, backlog, flags);
+	 	}
+
+		socket pf_tcp6_new_listener(std::string &addr, int backlog, int flags) {
+		 	return pf_tcp_new_listener(AF_INET6, addr, backlog, flags);
+	 	}
 
 		socket pf_tcp_new_connection(int domain, std::string &addr, std::error_code &e) {
 			auto lookup = resolve_inet_address(domain, SOCK_STREAM, false, addr);
@@ -230,6 +241,79 @@ namespace clane {
 			return tot;
 		}
 
+		size_t pf_tcpx_sendv(socket_descriptor &sd, iovec const *iov, size_t cnt, int flags, std::error_code &e) {
+			iovec *pos = const_cast<iovec *>(iov);
+			iovec *end = pos + cnt;
+			std::vector<iovec> rest; // copy of the unsent buffers, after a partial send
+			size_t tot = 0;
+			while (true) {
+				msghdr msg{};
+				msg.msg_iov = pos;
+				msg.msg_iovlen = end - pos;
+				ssize_t stat = TEMP_FAILURE_RETRY(::sendmsg(sd.n, &msg, MSG_NOSIGNAL));
+				if (-1 == stat) {
+					switch (errno) {
+						case EACCES:
+						case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+						case EWOULDBLOCK:
+#endif
+						case ECONNRESET:
+					 	case EPIPE:
+						case ENOBUFS:
+						case ETIMEDOUT:
+							e.assign(errno, os_category());
+							return 0;
+						default:
+							throw std::system_error(errno, os_category(), "sendmsg");
+					}
+				}
+				tot += stat;
+				size_t left = stat;
+				while (pos != end && left >= pos->iov_len) {
+					left -= pos->iov_len;
+					++pos;
+				}
+				if (!(flags & all) || pos == end)
+					return tot;
+				if (rest.empty()) {
+					rest.assign(pos, end);
+					pos = rest.data();
+					end = pos + rest.size();
+				}
+				pos->iov_base = reinterpret_cast<char *>(pos->iov_base) + left;
+				pos->iov_len -= left;
+			}
+		}
+
+		size_t pf_tcpx_sendfile(socket_descriptor &sd, int in_fd, off_t &offset, size_t n, int flags, std::error_code &e) {
+			size_t tot = 0;
+			do {
+				ssize_t stat = TEMP_FAILURE_RETRY(::sendfile(sd.n, in_fd, &offset, n-tot));
+				if (-1 == stat) {
+					switch (errno) {
+						case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+						case EWOULDBLOCK:
+#endif
+						case ECONNRESET:
+					 	case EPIPE:
+						case EIO:
+						case ENOBUFS:
+						case ETIMEDOUT:
+							e.assign(errno, os_category());
+							return tot;
+						default:
+							throw std::system_error(errno, os_category(), "sendfile");
+					}
+				}
+				if (!stat)
+					break; // end of file
+				tot += stat;
+			} while (flags & all && tot < n);
+			return tot;
+		}
+
 		size_t pf_tcpx_recv(socket_descriptor &sd, void *p, size_t n, int flags, std::error_code &e) {
 			char *const ppos = reinterpret_cast<char *>(p);
 			size_t tot = 0;
@@ -274,6 +358,8 @@ namespace clane {
 			pf_unimpl_remote_address,
 			pf_unimpl_accept,
 			pf_unimpl_send,
+			pf_unimpl_sendv,
+			pf_unimpl_sendfile,
 			pf_unimpl_recv,
 			pf_unimpl_fin
 		};
@@ -289,6 +375,8 @@ namespace clane {
 			pf_tcp4_remote_address,
 			pf_tcp4_accept,
 			pf_tcpx_send,
+			pf_tcpx_sendv,
+			pf_tcpx_sendfile,
 			pf_tcpx_recv,
 			pf_tcpx_fin
 		};
@@ -304,6 +392,8 @@ namespace clane {
 			pf_tcp6_remote_address,
 			pf_tcp6_accept,
 			pf_tcpx_send,
+			pf_tcpx_sendv,
+			pf_tcpx_sendfile,
 			pf_tcpx_recv,
 			pf_tcpx_fin
 		};
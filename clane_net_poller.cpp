@@ -53,6 +53,63 @@ namespace clane {
 			}
 			return res;
 		}
+
+		reactor::reactor() {
+			fd = ::epoll_create1(EPOLL_CLOEXEC);
+			if (-1 == fd)
+				throw std::system_error(errno, os_category(), "epoll_create1");
+		}
+
+		void reactor::add_fd(int pfd, int ev_flags, void *data) {
+			epoll_event ev{};
+			ev.events = ev_flags | EPOLLET;
+			ev.data.ptr = data;
+			if (-1 == ::epoll_ctl(fd, EPOLL_CTL_ADD, pfd, &ev))
+				throw std::system_error(errno, os_category(), "epoll_ctl: add");
+		}
+
+		void reactor::modify_fd(int pfd, int ev_flags, void *data) {
+			epoll_event ev{};
+			ev.events = ev_flags | EPOLLET;
+			ev.data.ptr = data;
+			if (-1 == ::epoll_ctl(fd, EPOLL_CTL_MOD, pfd, &ev))
+				throw std::system_error(errno, os_category(), "epoll_ctl: modify");
+		}
+
+		void reactor::remove_fd(int pfd) {
+			epoll_event ev{}; // non-null for kernels older than 2.6.9
+			if (-1 == ::epoll_ctl(fd, EPOLL_CTL_DEL, pfd, &ev))
+				throw std::system_error(errno, os_category(), "epoll_ctl: remove");
+		}
+
+		size_t reactor::wait(reactor_event *evs, size_t n) {
+			return wait(evs, n, -1);
+		}
+
+		size_t reactor::wait(reactor_event *evs, size_t n, std::chrono::steady_clock::time_point const &to) {
+			// Round up so as not to wake before the deadline and spin.
+			auto rem = to - std::chrono::steady_clock::now() + std::chrono::milliseconds(1) - std::chrono::steady_clock::duration(1);
+			int msecs = std::max(0, static_cast<int>(rem / std::chrono::milliseconds(1)));
+			return wait(evs, n, msecs);
+		}
+
+		size_t reactor::wait(reactor_event *evs, size_t n, std::chrono::steady_clock::duration const &to) {
+			int msecs = std::max(0, static_cast<int>(to / std::chrono::milliseconds(1)));
+			return wait(evs, n, msecs);
+		}
+
+		size_t reactor::wait(reactor_event *evs, size_t n, int to) {
+			if (ready.size() < n)
+				ready.resize(n);
+			int stat = TEMP_FAILURE_RETRY(::epoll_wait(fd, ready.data(), static_cast<int>(n), to));
+			if (-1 == stat)
+				throw std::system_error(errno, os_category(), "epoll_wait");
+			for (int i = 0; i < stat; ++i) {
+				evs[i].data = ready[i].data.ptr;
+				evs[i].events = ready[i].events;
+			}
+			return stat;
+		}
 	}
 }
 
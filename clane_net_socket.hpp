@@ -34,13 +34,15 @@ namespace clane {
 		inline void pf_unimpl_construct_descriptor(socket_descriptor &) { pf_unsupported(); }
 		inline void pf_unimpl_destruct_destriptor(socket_descriptor &) { pf_unsupported(); }
 		inline int pf_unimpl_descriptor(socket_descriptor const &) { pf_unsupported(); }
-		inline socket pf_unimpl_new_listener(std::string &, int) { pf_unsupported(); }
+		inline socket pf_unimpl_new_listener(std::string &, int, int) { pf_unsupported(); }
 		inline socket pf_unimpl_new_connection(std::string &, std::error_code &) { pf_unsupported(); }
 		inline void pf_unimpl_set_nonblocking(socket_descriptor &) { pf_unsupported(); }
 		inline std::string pf_unimpl_local_address(socket_descriptor &) { pf_unsupported(); }
 		inline std::string pf_unimpl_remote_address(socket_descriptor &) { pf_unsupported(); }
 		inline socket pf_unimpl_accept(socket_descriptor &, std::string *, std::error_code &) { pf_unsupported(); }
 		inline size_t pf_unimpl_send(socket_descriptor &, void const *, size_t, int, std::error_code &) { pf_unsupported(); }
+		inline size_t pf_unimpl_sendv(socket_descriptor &, iovec const *, size_t, int, std::error_code &) { pf_unsupported(); }
+		inline size_t pf_unimpl_sendfile(socket_descriptor &, int, off_t &, size_t, int, std::error_code &) { pf_unsupported(); }
 		inline size_t pf_unimpl_recv(socket_descriptor &, void *, size_t, int, std::error_code &) { pf_unsupported(); }
 		inline void pf_unimpl_fin(socket_descriptor &) { pf_unsupported(); }
 	}
@@ -0,0 +1,122 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// vim: set noet:
+
+/** @file */
+
+#include "clane_sync_thread_pool.hpp"
+#include <algorithm>
+#include <sched.h>
+#include <system_error>
+
+namespace clane {
+	namespace sync {
+
+		thread_pool::~thread_pool() {
+			stop();
+		}
+
+		thread_pool::thread_pool(size_t size, size_t queue_depth, size_t stack_size): max_queue{queue_depth},
+		 	stopping{}, stats_() {
+
+			pthread_attr_t attr;
+			int stat = pthread_attr_init(&attr);
+			if (stat)
+				throw std::system_error(stat, std::generic_category(), "pthread_attr_init");
+			if (stack_size && (stat = pthread_attr_setstacksize(&attr, stack_size))) {
+				pthread_attr_destroy(&attr);
+				throw std::system_error(stat, std::generic_category(), "pthread_attr_setstacksize");
+			}
+
+			// start worker threads:
+			size = std::max(static_cast<size_t>(1), size);
+			workers.reserve(size);
+			for (size_t i = 0; i < size; ++i) {
+				pthread_t thrd;
+				stat = pthread_create(&thrd, &attr, &thread_pool::worker_main, this);
+				if (stat) {
+					pthread_attr_destroy(&attr);
+					stop();
+					throw std::system_error(stat, std::generic_category(), "pthread_create");
+				}
+				workers.push_back(thrd);
+			}
+			pthread_attr_destroy(&attr);
+		}
+
+		bool thread_pool::submit(task &&t) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (max_queue && queue.size() >= max_queue) {
+				++stats_.rejected;
+				return false;
+			}
+			queue.push_back(item{std::move(t), std::chrono::steady_clock::now()});
+			cond.notify_one();
+			return true;
+		}
+
+		thread_pool::statistics thread_pool::stats() {
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics s = stats_;
+			s.queued = queue.size();
+			return s;
+		}
+
+		void *thread_pool::worker_main(void *arg) {
+			static_cast<thread_pool *>(arg)->run();
+			return nullptr;
+		}
+
+		void thread_pool::run() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true) {
+				while (queue.empty() && !stopping)
+					cond.wait(lock);
+				if (queue.empty())
+					return; // stopping, and no more tasks
+				item i = std::move(queue.front());
+				queue.pop_front();
+				auto wait = std::chrono::steady_clock::now() - i.queued;
+				++stats_.started;
+				stats_.total_wait += wait;
+				stats_.max_wait = std::max(stats_.max_wait, wait);
+				lock.unlock();
+				i.t();
+				i.t = nullptr; // destroy task state outside the lock
+				lock.lock();
+			}
+		}
+
+		void thread_pool::stop() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+				cond.notify_all();
+			}
+			for (auto i = workers.begin(); i != workers.end(); ++i)
+				pthread_join(*i, nullptr);
+			workers.clear();
+		}
+
+		void pin_thread(size_t n) {
+			cpu_set_t allowed;
+			if (-1 == sched_getaffinity(0, sizeof(allowed), &allowed))
+				throw std::system_error(errno, std::generic_category(), "sched_getaffinity");
+			n %= CPU_COUNT(&allowed);
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+				if (!CPU_ISSET(cpu, &allowed) || n--)
+					continue;
+				cpu_set_t one;
+				CPU_ZERO(&one);
+				CPU_SET(cpu, &one);
+				int stat = pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+				if (stat)
+					throw std::system_error(stat, std::generic_category(), "pthread_setaffinity_np");
+				return;
+			}
+		}
+	}
+}
+
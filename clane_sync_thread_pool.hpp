@@ -0,0 +1,21 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// vim: set noet:
+
+#ifndef CLANE_SYNC_THREAD_POOL_HPP
+#define CLANE_SYNC_THREAD_POOL_HPP
+
+/** @file */
+
+#include "clane_base.hpp"
+#include "include/clane_sync_pub.hpp"
+
+namespace clane {
+	namespace sync {
+
+	}
+}
+
+#endif // #ifndef CLANE_SYNC_THREAD_POOL_HPP
@@ -12,15 +12,60 @@
 #include "clane_base_pub.hpp"
 #include "clane_http_pub.hpp"
 #include <boost/filesystem.hpp>
+#include <chrono>
+#include <memory>
 
 namespace clane {
 	namespace http {
 
+		class file_cache;
+		class memory_file_cache;
+
 		class file_server {
 			boost::filesystem::path root_path;
+			std::shared_ptr<file_cache> cache;
+			std::shared_ptr<memory_file_cache> mem_cache;
 		public:
+			static size_t const max_default_cache_capacity = 1024;
+			static size_t const default_memory_max_file_size = 64 * 1024;
+
+			/** @brief Returns the cache capacity of a file_server constructed
+			 * without a cache configuration
+			 *
+			 * @remark The default capacity is one sixteenth of the process's soft
+			 * limit on open file descriptors, `RLIMIT_NOFILE`, but no more than
+			 * @ref max_default_cache_capacity. */
+			static size_t default_cache_capacity();
+
 			~file_server() = default;
-			file_server(boost::filesystem::path const &root_path): root_path{root_path} {}
+			file_server(boost::filesystem::path const &root_path);
+
+			/** @brief Constructs a file_server with a given cache configuration
+			 *
+			 * @remark A file_server caches open file descriptors and file metadata
+			 * for up to @p cache_capacity paths, each for up to @p cache_ttl, so that
+			 * it can serve frequently requested files without looking them up in
+			 * the file system. Changes to a file may go unnoticed until its cache
+			 * entry expires. Expired entries are evicted, closing their
+			 * descriptors, on the next lookup. A @p cache_capacity of zero disables
+			 * caching. By default, the cache holds @ref default_cache_capacity()
+			 * paths for one second each.
+			 *
+			 * @remark If @p memory_budget is nonzero then the file_server also
+			 * keeps the contents of files no larger than @p memory_max_file_size
+			 * in memory, evicting the least recently used files to stay within
+			 * @p memory_budget bytes. A file_server serves a file held in memory
+			 * with one write and no file system access.
+			 *
+			 * @remark A GET or HEAD request with If-None-Match or
+			 * If-Modified-Since is checked against the file's metadata first—its
+			 * cache entry, if any, or else stat(2)—so that answering it with 304
+			 * Not Modified never opens the file.
+			 *
+			 * @remark Copies of a file_server share the same caches. */
+			file_server(boost::filesystem::path const &root_path, size_t cache_capacity,
+				std::chrono::steady_clock::duration cache_ttl, size_t memory_budget = 0,
+				size_t memory_max_file_size = default_memory_max_file_size);
 			file_server(file_server const &) = default;
 			file_server &operator=(file_server const &) = default;
 #ifndef CLANE_HAVE_NO_DEFAULT_MOVE
@@ -36,6 +81,8 @@ namespace clane {
 
 		inline void file_server::swap(file_server &that) noexcept {
 			std::swap(root_path, that.root_path);
+			std::swap(cache, that.cache);
+			std::swap(mem_cache, that.mem_cache);
 		}
 	}
 }
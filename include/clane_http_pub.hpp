@@ -17,10 +17,14 @@
 #include "clane_sync_pub.hpp"
 #include "clane_uri_pub.hpp"
 #include <deque>
+#include <functional>
 #include <istream>
 #include <map>
+#include <initializer_list>
 #include <memory>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
 
 namespace clane {
 
@@ -126,6 +130,35 @@ namespace clane {
 		 * */
 		char const *what(status_code n);
 
+		/** @brief Set of HTTP request methods, as a bit mask
+		 *
+		 * @remark Each standard method has its own bit, and all extension
+		 * methods—i.e., methods other than the standard ones—share the
+		 * method_other bit. */
+		typedef unsigned method_set;
+
+		// HTTP request methods: These are constants of type method_set rather
+		// than enumerators so that overloads taking a method_set, e.g.,
+		// basic_route::method(), win over templates.
+		static method_set const method_get = 1 << 0; ///< @brief GET method
+		static method_set const method_head = 1 << 1; ///< @brief HEAD method
+		static method_set const method_post = 1 << 2; ///< @brief POST method
+		static method_set const method_put = 1 << 3; ///< @brief PUT method
+		static method_set const method_delete = 1 << 4; ///< @brief DELETE method
+		static method_set const method_connect = 1 << 5; ///< @brief CONNECT method
+		static method_set const method_options = 1 << 6; ///< @brief OPTIONS method
+		static method_set const method_trace = 1 << 7; ///< @brief TRACE method
+		static method_set const method_patch = 1 << 8; ///< @brief PATCH method
+		static method_set const method_other = 1 << 9; ///< @brief Any extension method
+		static method_set const method_any = (1 << 10) - 1; ///< @brief All methods
+
+		/** @brief Returns the method bit for a given request method
+		 *
+		 * @remark Method names are case-sensitive, so, e.g., `"GET"` is
+		 * method_get but `"get"` is an extension method and yields
+		 * method_other. */
+		method_set parse_method(std::string const &s);
+
 		class header_name_less {
 		public:
 			bool operator()(std::string const &a, std::string const &b) const { return clane::ascii::icase_compare(a, b) < 0; }
@@ -136,17 +169,298 @@ namespace clane {
 			bool operator()(std::string const &a, std::string const &b) const { return clane::ascii::icase_compare(a, b) == 0; }
 		};
 
-		/** @brief Map type for pairing HTTP header names to header values
+		/** @brief HTTP header name–value pair
 		 *
 		 * @remark Header names are case-insensitive, and header values are case
 		 * sensitive. */
-		typedef std::multimap<std::string, std::string, header_name_less> header_map;
+		class header {
+		public:
+			std::string first; ///< @brief Name
+			std::string second; ///< @brief Value
+			~header() {}
+			header() {}
+			template <typename Name, typename Value> header(Name &&name, Value &&value):
+				first(std::forward<Name>(name)), second(std::forward<Value>(value)) {}
+			template <typename Name, typename Value> header(std::pair<Name, Value> const &p):
+				first(p.first), second(p.second) {}
+			template <typename Name, typename Value> header(std::pair<Name, Value> &&p):
+				first(std::move(p.first)), second(std::move(p.second)) {}
+			header(header const &) = default;
+			header &operator=(header const &) = default;
+#ifndef CLANE_HAVE_NO_DEFAULT_MOVE
+			header(header &&) = default;
+			header &operator=(header &&) = default;
+#else
+			header(header &&that) noexcept: first(std::move(that.first)), second(std::move(that.second)) {}
+			header &operator=(header &&that) noexcept { first = std::move(that.first); second = std::move(that.second); return *this; }
+#endif
+		};
 
-		/** @brief HTTP header name–value pair
+		/** @brief Identifies a well-known HTTP header name
 		 *
-		 * @remark Header names are case-insensitive, and header values are case
-		 * sensitive. */
-		typedef header_map::value_type header;
+		 * @remark Well-known header names are interned in a perfect-hash table,
+		 * so finding a name's ID takes one table lookup and one name comparison,
+		 * regardless of how many names there are. Any other name is
+		 * header_id::unknown. */
+		enum class header_id: unsigned char {
+			accept,
+			accept_charset,
+			accept_encoding,
+			accept_language,
+			accept_ranges,
+			access_control_allow_credentials,
+			access_control_allow_headers,
+			access_control_allow_methods,
+			access_control_allow_origin,
+			access_control_expose_headers,
+			access_control_max_age,
+			access_control_request_headers,
+			access_control_request_method,
+			age,
+			allow,
+			authorization,
+			cache_control,
+			connection,
+			content_disposition,
+			content_encoding,
+			content_language,
+			content_length,
+			content_location,
+			content_md5,
+			content_range,
+			content_security_policy,
+			content_type,
+			cookie,
+			date,
+			dnt,
+			etag,
+			expect,
+			expires,
+			forwarded,
+			from,
+			host,
+			if_match,
+			if_modified_since,
+			if_none_match,
+			if_range,
+			if_unmodified_since,
+			keep_alive,
+			last_modified,
+			link,
+			location,
+			max_forwards,
+			origin,
+			pragma,
+			proxy_authenticate,
+			proxy_authorization,
+			range,
+			referer,
+			retry_after,
+			server,
+			set_cookie,
+			strict_transport_security,
+			te,
+			trailer,
+			transfer_encoding,
+			upgrade,
+			upgrade_insecure_requests,
+			user_agent,
+			vary,
+			via,
+			warning,
+			www_authenticate,
+			x_content_type_options,
+			x_forwarded_for,
+			x_forwarded_host,
+			x_forwarded_proto,
+			x_frame_options,
+			x_requested_with,
+			unknown
+		};
+
+		/** @brief Returns the ID of a header name, or header_id::unknown if the
+		 * name isn't well-known
+		 *
+		 * @remark Header names are case-insensitive. */
+		header_id find_header_id(char const *name, size_t size);
+
+		/** @brief Returns the ID of a header name, or header_id::unknown if the
+		 * name isn't well-known */
+		inline header_id find_header_id(std::string const &name) {
+			return find_header_id(name.data(), name.size());
+		}
+
+		/** @brief Returns the HTTP 1.x spelling of a well-known header name—e.g.,
+		 * <code>"Content-Length"</code>—or null for header_id::unknown */
+		char const *header_name(header_id id);
+
+		/** @brief Returns a case-insensitive hash of an HTTP header name
+		 *
+		 * @remark The hash of a well-known header name is its header_id, and the
+		 * hash of any other name has the most significant bit set. Hence two
+		 * names with the same well-known hash are equal. */
+		inline size_t header_name_hash(std::string const &name) {
+			header_id const id = find_header_id(name);
+			if (header_id::unknown != id)
+				return static_cast<size_t>(id);
+			// FNV-1a
+			size_t h = static_cast<size_t>(2166136261u);
+			for (auto i = name.begin(); i != name.end(); ++i) {
+				unsigned char c = *i;
+				if (c >= 'A' && c <= 'Z')
+					c += 'a' - 'A';
+				h = (h ^ c) * 16777619u;
+			}
+			return h | ~(static_cast<size_t>(-1) >> 1);
+		}
+
+		/** @brief Container for pairing HTTP header names to header values
+		 *
+		 * @remark A header_map is a multimap, with much the same interface as
+		 * `std::multimap<std::string, std::string>`. Header names are
+		 * case-insensitive, and header values are case sensitive. The map orders
+		 * headers by name, and headers with the same name stay in the order in
+		 * which they were inserted.
+		 *
+		 * @remark Unlike `std::multimap`, a header_map stores its headers in one
+		 * flat array—in place, without allocating, for up to @ref
+		 * inline_capacity headers—along with a precomputed hash of each header
+		 * name. Looking up a header compares hashes before comparing names, and
+		 * a well-known name's hash is its header_id, so looking up a well-known
+		 * header compares no names at all.
+		 *
+		 * @remark Also unlike `std::multimap`, inserting or erasing headers
+		 * invalidates iterators. Applications mustn't change a header's name via
+		 * an iterator. */
+		class header_map {
+		public:
+			typedef std::string key_type;
+			typedef std::string mapped_type;
+			typedef header value_type;
+			typedef header &reference;
+			typedef header const &const_reference;
+			typedef header *iterator;
+			typedef header const *const_iterator;
+			typedef size_t size_type;
+			typedef std::ptrdiff_t difference_type;
+
+			/** @brief Number of headers that a header_map holds without
+			 * allocating */
+			static size_t const inline_capacity = 16;
+
+		private:
+			typedef std::aligned_storage<sizeof(header), std::alignment_of<header>::value>::type header_storage;
+			header *hdrs;
+			size_t *hashes;
+			size_t size_;
+			size_t capacity_;
+			header_storage inline_hdrs[inline_capacity];
+			size_t inline_hashes[inline_capacity];
+
+		public:
+			~header_map();
+			header_map(): hdrs{reinterpret_cast<header *>(inline_hdrs)}, hashes{inline_hashes}, size_{},
+				capacity_{inline_capacity} {}
+			header_map(std::initializer_list<header> il);
+			template <typename InputIter> header_map(InputIter first, InputIter last);
+			header_map(header_map const &that);
+			header_map &operator=(header_map const &that);
+			header_map(header_map &&that) noexcept;
+			header_map &operator=(header_map &&that) noexcept;
+			void swap(header_map &that) noexcept;
+
+			iterator begin() { return hdrs; }
+			iterator end() { return hdrs + size_; }
+			const_iterator begin() const { return hdrs; }
+			const_iterator end() const { return hdrs + size_; }
+			const_iterator cbegin() const { return hdrs; }
+			const_iterator cend() const { return hdrs + size_; }
+			bool empty() const { return !size_; }
+			size_t size() const { return size_; }
+
+			iterator insert(header const &h) { return insert(header(h)); }
+			iterator insert(header &&h);
+			template <typename InputIter> void insert(InputIter first, InputIter last);
+			template <typename... Args> iterator emplace(Args&&... args) {
+				return insert(header(std::forward<Args>(args)...));
+			}
+			iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+			iterator erase(const_iterator first, const_iterator last);
+			size_t erase(std::string const &name);
+			void clear();
+
+			iterator find(std::string const &name);
+			const_iterator find(std::string const &name) const;
+			std::pair<iterator, iterator> equal_range(std::string const &name);
+			std::pair<const_iterator, const_iterator> equal_range(std::string const &name) const;
+			size_t count(std::string const &name) const;
+
+			/** @brief Finds a well-known header by ID, without comparing names
+			 *
+			 * @remark Finding header_id::unknown finds nothing. */
+			iterator find(header_id id);
+			const_iterator find(header_id id) const;
+			std::pair<iterator, iterator> equal_range(header_id id);
+			std::pair<const_iterator, const_iterator> equal_range(header_id id) const;
+			size_t count(header_id id) const;
+			size_t erase(header_id id);
+
+			/** @brief Returns the ID of a header's name, which the map determines
+			 * upon insertion */
+			header_id id(const_iterator pos) const;
+
+		private:
+			size_t find_index(std::string const &name, size_t hash) const;
+			size_t find_index(header_id id) const;
+			size_t upper_bound_index(std::string const &name) const;
+			void reserve(size_t n);
+			void move_from(header_map &that) noexcept;
+		};
+
+		template <typename InputIter> header_map::header_map(InputIter first, InputIter last):
+			hdrs{reinterpret_cast<header *>(inline_hdrs)}, hashes{inline_hashes}, size_{}, capacity_{inline_capacity} {
+			insert(first, last);
+		}
+
+		template <typename InputIter> void header_map::insert(InputIter first, InputIter last) {
+			for (; first != last; ++first)
+				insert(header(*first));
+		}
+
+		inline header_map::iterator header_map::find(std::string const &name) {
+			return hdrs + find_index(name, header_name_hash(name));
+		}
+
+		inline header_map::const_iterator header_map::find(std::string const &name) const {
+			return hdrs + find_index(name, header_name_hash(name));
+		}
+
+		inline size_t header_map::count(std::string const &name) const {
+			auto r = equal_range(name);
+			return r.second - r.first;
+		}
+
+		inline header_map::iterator header_map::find(header_id id) {
+			return hdrs + find_index(id);
+		}
+
+		inline header_map::const_iterator header_map::find(header_id id) const {
+			return hdrs + find_index(id);
+		}
+
+		inline size_t header_map::count(header_id id) const {
+			auto r = equal_range(id);
+			return r.second - r.first;
+		}
+
+		inline header_id header_map::id(const_iterator pos) const {
+			size_t const hash = hashes[pos - hdrs];
+			return hash < static_cast<size_t>(header_id::unknown) ? static_cast<header_id>(hash) : header_id::unknown;
+		}
+
+		inline void swap(header_map &a, header_map &b) noexcept {
+			a.swap(b);
+		}
 
 		inline bool header_equal(header const &a, header const &b) {
 			return clane::ascii::icase_compare(a.first, b.first) == 0 && a.second == b.second;
@@ -329,6 +643,7 @@ namespace clane {
 				newline
 			} cur_stat;
 			std::string method_;
+			method_set method_id_;
 			uri::uri uri_;
 			int major_ver;
 			int minor_ver;
@@ -347,9 +662,19 @@ namespace clane {
 			void reset();
 			size_t parse_some(char const *beg, char const *end);
 
+			/** @brief Parses a request line that's entirely in memory, in one pass
+			 *
+			 * @remark The parser must be newly reset. The parse_whole() function
+			 * returns the number of bytes parsed, including the line end, or else
+			 * `0` if the line is incomplete, invalid, or exceeds the length limit,
+			 * in which case the caller should reset the parser and parse
+			 * incrementally. */
+			size_t parse_whole(char const *beg, char const *end);
+
 			// accessors:
 			std::string const &method() const { return method_; }
 			std::string &method() { return method_; }
+			method_set method_id() const { return method_id_; }
 			uri::uri const &uri() const { return uri_; }
 			uri::uri &uri() { return uri_; }
 			int major_version() const { return major_ver; }
@@ -390,6 +715,21 @@ namespace clane {
 			std::string &reason() { return reason_; }
 		};
 
+		/** @brief HTTP header whose name and value refer to memory that the
+		 * header doesn't own
+		 *
+		 * @remark A header view is valid only as long as the memory it refers to.
+		 * */
+		class header_view {
+		public:
+			char const *name;
+			size_t name_size;
+			char const *value;
+			size_t value_size;
+			std::string name_str() const { return std::string(name, name_size); }
+			std::string value_str() const { return std::string(value, value_size); }
+		};
+
 		class v1x_headers_incparser: virtual public incparser {
 			enum class state {
 				start_line,      // expecting a header or an empty line
@@ -403,11 +743,18 @@ namespace clane {
 			header_map hdrs;
 			std::string hdr_name;
 			std::string hdr_val;
+			bool view_mode;
+			std::vector<header_view> views;
+			std::vector<std::unique_ptr<std::string>> copies; // names and values that couldn't be views
+			header_view pend;                                  // header in progress
+			char const *keep(std::string &&s);
+			void spill_value();
+			void copy_views(v1x_headers_incparser const &that);
 		public:
 			~v1x_headers_incparser() {}
-			v1x_headers_incparser() {}
-			v1x_headers_incparser(v1x_headers_incparser const &) = default;
-			v1x_headers_incparser &operator=(v1x_headers_incparser const &) = default;
+			v1x_headers_incparser(): view_mode{} {}
+			v1x_headers_incparser(v1x_headers_incparser const &that);
+			v1x_headers_incparser &operator=(v1x_headers_incparser const &that);
 #ifndef CLANE_HAVE_NO_DEFAULT_MOVE
 			v1x_headers_incparser(v1x_headers_incparser &&) = default;
 			v1x_headers_incparser &operator=(v1x_headers_incparser &&) = default;
@@ -416,14 +763,40 @@ namespace clane {
 			void reset();
 			size_t parse_some(char const *beg, char const *end);
 
+			/** @brief Sets whether the parser records headers as views instead of
+			 * copying them into the header map
+			 *
+			 * @remark In view mode, the parser stores each header as a
+			 * header_view into the memory passed to parse_some(), so the caller
+			 * must keep that memory alive and unchanged until it's done with the
+			 * views. Only a header that spans two blocks or uses obsolete line
+			 * folding is copied, into memory owned by the parser, which lasts
+			 * until the next reset(). The headers() map stays empty.
+			 *
+			 * @remark Copying or moving a parser carries its copied headers along,
+			 * and the views of the new parser refer to them. Views into memory
+			 * passed to parse_some() still refer to that memory.
+			 *
+			 * @remark The mode persists across calls to reset(). */
+			void set_view_mode(bool on) { view_mode = on; }
+
+			/** @brief Parses a header block that's entirely in memory, in one pass
+			 *
+			 * @remark The parser must be newly reset and not in view mode. The
+			 * parse_whole() function returns the number of bytes parsed, including
+			 * the empty line, or else `0` if the block is incomplete, invalid,
+			 * exceeds the length limit, or uses obsolete line folding, in which
+			 * case the caller should reset the parser and parse incrementally. */
+			size_t parse_whole(char const *beg, char const *end);
+
 			// accessors:
 			header_map const &headers() const { return hdrs; }
 			header_map &headers() { return hdrs; }
+			std::vector<header_view> const &header_views() const { return views; }
 		};
 
 		// Does not check against maximum length limit.
 		class v1x_chunk_line_incparser: virtual public incparser {
-			static int const max_nibs = 2 * sizeof(size_t);
 			enum class state {
 				digit,
 				newline
@@ -439,8 +812,8 @@ namespace clane {
 			v1x_chunk_line_incparser(v1x_chunk_line_incparser &&) = default;
 			v1x_chunk_line_incparser &operator=(v1x_chunk_line_incparser &&) = default;
 #endif
-			// Note: Ignores length limit, uses fixed length limit based on
-			// sizeof(size_t).
+			// Note: Ignores length limit. A chunk size that overflows size_t is an
+			// error.
 			void reset();
 			size_t parse_some(char const *beg, char const *end);
 
@@ -499,6 +872,7 @@ namespace clane {
 			size_t size_;
 			bool got_hdrs;
 			bool chunked;
+			size_t parse_head(char const *beg, char const *end);
 		public:
 			~v1x_request_incparser() = default;
 			v1x_request_incparser() = default;
@@ -562,29 +936,77 @@ namespace clane {
 			header_map &trailers() { return v1x_headers_incparser::headers(); }
 		};
 
+		/** @brief Parameter that a route captures from a request path
+		 *
+		 * @remark A route path pattern such as `"^/users/{id}$"` captures the
+		 * path segment that matches each `{name}` parameter. The value is a view
+		 * into the request's path—not a copy—so it remains valid only while the
+		 * path is unchanged.
+		 *
+		 * @sa basic_route */
+		class path_param {
+		public:
+			std::string name;
+			char const *data;
+			size_t size;
+			std::string str() const { return std::string(data, size); }
+		};
+
 		class request {
 		public:
 			std::string method;
+
+			/** @brief Method bit for the @ref method member, or zero if unknown
+			 *
+			 * @remark The server sets the method bit when parsing the request
+			 * line, so that handlers may test the method without comparing
+			 * strings. Applications that change the @ref method member must also
+			 * update or zero the method bit. */
+			method_set method_id;
+
 			uri::uri uri;
 			int major_version;
 			int minor_version;
 			header_map headers;
 			header_map trailers;
+
+			/** @brief Path parameters captured by the matching route, in order
+			 * of appearance in the route path pattern */
+			std::vector<path_param> path_params;
+
 			std::istream body;
 		private:
 			std::unique_ptr<std::streambuf> sb;
 		public:
 			~request() = default;
-			request(std::streambuf *sb): body{sb} {}
-			request(std::unique_ptr<std::streambuf> &&sb): body{sb.get()}, sb{std::move(sb)} {}
+			request(std::streambuf *sb): method_id{}, body{sb} {}
+			request(std::unique_ptr<std::streambuf> &&sb): method_id{}, body{sb.get()}, sb{std::move(sb)} {}
 			request(request const &) = delete;
 			request &operator=(request const &) = delete;
 #ifndef CLANE_HAVE_NO_DEFAULT_MOVE
 			request(request &&) = default;
 			request &operator=(request &&) = default;
 #endif
+
+			/** @brief Returns the path parameter with a given name, or `nullptr`
+			 * if none */
+			path_param const *find_path_param(std::string const &name) const;
 		};
 
+		// Returns the method bit for a request, parsing the method if the request
+		// doesn't have the bit set.
+		inline method_set request_method_id(request const &req) {
+			return req.method_id ? req.method_id : parse_method(req.method);
+		}
+
+		inline path_param const *request::find_path_param(std::string const &name) const {
+			for (auto i = path_params.begin(); i != path_params.end(); ++i) {
+				if (i->name == name)
+					return &*i;
+			}
+			return nullptr;
+		}
+
 		/** @brief Server-side class for writing an HTTP response message */
 		class response_ostream: public std::ostream {
 		public:
@@ -594,8 +1016,9 @@ namespace clane {
 			 * @remark Applications may set the @ref status member to send an
 			 * HTTP response message with a @link status_code status code
 			 * @endlink other than the default value of `200 OK`. Setting the
-			 * @ref status member has no effect after at least one byte of the
-			 * body has been inserted into the response_ostream instance. */
+			 * @ref status member has no effect once the response_ostream instance
+			 * has begun sending the response, which may happen as soon as the
+			 * first byte of the body has been inserted. */
 			status_code &status;
 
 			/** @brief Headers to send
@@ -603,8 +1026,9 @@ namespace clane {
 			 * @remark Applications may insert one or more @link header HTTP
 			 * headers @endlink into the @ref headers member to send those
 			 * headers as part of the response message. Setting the @ref headers
-			 * member has no effect after at least one byte of the body has been
-			 * inserted into the response_ostream instance. */
+			 * member has no effect once the response_ostream instance has begun
+			 * sending the response, which may happen as soon as the first byte of
+			 * the body has been inserted. */
 			header_map &headers;
 
 		public:
@@ -621,12 +1045,16 @@ namespace clane {
 		inline response_ostream::response_ostream(std::streambuf *sb, status_code &stat_code, header_map &hdrs):
 		 	std::ostream{sb}, status(stat_code), headers(hdrs) {}
 
+		class server_connection;
+		class server_context;
+
 		class server_streambuf: public std::streambuf {
 			struct buffer {
 				std::shared_ptr<char> p;
 				size_t size;
 			};
-			net::socket &sock;
+			server_connection &conn;
+			size_t seq;
 			int major_ver;
 			int minor_ver;
 		public:
@@ -637,16 +1065,14 @@ namespace clane {
 			bool in_end;
 			std::deque<buffer> in_queue;
 			std::condition_variable in_cond;
-			std::mutex act_mutex;
-			std::condition_variable act_cond;
 			bool enabled;
-			bool active;
+			bool may_block;
 			bool hdrs_written;
 			bool chunked;
 			char out_buf[4096];
 		public:
 			virtual ~server_streambuf();
-			server_streambuf(net::socket &sock);
+			server_streambuf(server_connection &conn, size_t seq);
 			server_streambuf(server_streambuf const &) = default;
 			server_streambuf &operator=(server_streambuf const &) = default;
 #ifndef CLANE_HAVE_NO_DEFAULT_MOVE
@@ -657,36 +1083,152 @@ namespace clane {
 			void set_version(int major, int minor) { major_ver = major; minor_ver = minor; }
 			void more_request_body(std::shared_ptr<char> const &p, size_t offset, size_t size);
 			void end_request_body();
-			void inactivate();
-			void activate();
+			bool send_file(std::shared_ptr<posix::unique_fd> const &fd, off_t offset, size_t size);
+			bool send_prepared(std::string const &hdr_lines, char const *body, size_t size);
+			void finish();
+			void reject(status_code stat);
 		protected:
 			virtual int sync();
 			virtual int_type underflow();
 			virtual int_type overflow(int_type ch);
 		private:
+			std::string render_headers() const;
 			int flush(bool end = false);
 		};
 
-		class server_context {
+		// Filter between a response_ostream and its server_streambuf that
+		// compresses the response body with gzip or deflate, as the client
+		// accepts.
+		//
+		// The filter holds back the first body data until it can decide whether
+		// to compress: it compresses only a successful response with a
+		// compressible content type and no content encoding of its own, and only
+		// if the body reaches the minimum size or the application flushes. Once
+		// decided, the filter fixes up the headers—Content-Encoding, Vary, and
+		// Content-Length—and then either compresses or passes data through.
+		//
+		// Each thread keeps its zlib state and buffers for reuse by the next
+		// response that it compresses.
+		class deflate_streambuf: public std::streambuf {
+		public:
+			struct deflater;
+		private:
+			enum class coding_type { none, gzip, deflate };
+			enum class state_type { disabled, undecided, passing, compressing };
+			server_streambuf &down;
+			std::unique_ptr<deflater> z;
+			coding_type coding;
+			state_type state;
+			int level;
+			size_t min_size;
+		public:
+			virtual ~deflate_streambuf();
+			deflate_streambuf(server_streambuf &down);
+			deflate_streambuf(deflate_streambuf const &) = delete;
+			deflate_streambuf &operator=(deflate_streambuf const &) = delete;
+			void enable(header_map const &req_hdrs, int level, size_t min_size);
+			server_streambuf *bypass();
+			void finish();
+		protected:
+			virtual int sync();
+			virtual int_type overflow(int_type ch);
+			virtual std::streamsize xsputn(char const *s, std::streamsize n);
+		private:
+			bool acquire();
+			void release();
+			void decide(bool end);
+			bool write_out(int flush);
+		};
+
+		// Queue of connections that an event loop should check for closing. Request
+		// handler threads push to the queue and wake the event loop.
+		class server_retire_queue {
+			std::mutex mutex;
+			std::vector<server_connection *> conns;
+		public:
+			net::event event;
+			void push(server_connection *conn);
+			std::vector<server_connection *> take();
+		};
+
+		// State for one connection served by an event loop.
+		//
+		// The event loop receives and parses requests until the client finishes
+		// sending, an error occurs, or the server terminates. Request handlers send
+		// response data directly to the socket where possible and otherwise append
+		// it to the connection's output queue, which the event loop drains
+		// whenever the socket becomes writable. The event loop closes the
+		// connection once it has stopped reading, every response has finished, and
+		// the output queue is empty.
+		//
+		// Between requests, a connection holds no parser, request context, or
+		// buffer, so that idle connections are cheap.
+		class server_connection {
 			sync::wait_group::reference wg_ref;
+			server_retire_queue *retire_queue;
+		public:
+			static size_t const out_limit = 64 * 1024; // output bytes queued before handlers block
+			net::socket sock;
+			std::unique_ptr<v1x_request_incparser> pars;
+			std::shared_ptr<server_context> cur_ctx;
+		private:
+			std::mutex out_mutex;
+			std::condition_variable out_cond;
+			// Queued output is either data or a segment of an open file.
+			struct out_item {
+				std::string data;
+				std::shared_ptr<posix::unique_fd> file;
+				off_t file_offset;
+				size_t file_size;
+			};
+			std::vector<out_item> out_queue;
+			size_t out_offset; // bytes of the front data item already sent
+			size_t out_size; // data bytes queued
+			std::error_code out_error;
+			size_t ctx_count; // number of responses begun
+			size_t done_count; // number of responses finished
+			bool reading;
+		public:
+			~server_connection() = default;
+			server_connection(sync::wait_group::reference &&wg_ref, server_retire_queue &retire_queue, net::socket &&sock):
+				wg_ref{std::move(wg_ref)}, retire_queue{&retire_queue}, sock{std::move(sock)}, out_offset{}, out_size{},
+				ctx_count{}, done_count{}, reading{true} {}
+			server_connection(server_connection const &) = delete;
+			server_connection(server_connection &&) = delete;
+			server_connection &operator=(server_connection const &) = delete;
+			server_connection &operator=(server_connection &&) = delete;
+			bool is_reading() const { return reading; } // for use by the event loop only
+			size_t begin_response();
+			void send(size_t seq, iovec const *iov, size_t cnt, bool block, std::error_code &e);
+			void send_file(size_t seq, std::shared_ptr<posix::unique_fd> const &fd, off_t offset, size_t size, bool block,
+				std::error_code &e);
+			void end_response(size_t seq);
+			bool is_turn(size_t seq);
+			void drain();
+			void stop_reading();
+			bool retirable();
+		private:
+			bool wait_to_send(std::unique_lock<std::mutex> &out_lock, size_t seq, bool block, std::error_code &e);
+			void fail(std::error_code const &e);
+			bool can_retire() const;
+		};
+
+		class server_context {
+			std::shared_ptr<server_connection> conn;
 		public:
 			server_streambuf sb;
+			deflate_streambuf zsb;
 			request req;
 			response_ostream rs;
-		private:
-			std::mutex next_mutex;
-			std::shared_ptr<server_context> next_ctx;
 		public:
-			~server_context();
-			server_context(sync::wait_group::reference &&wg_ref, net::socket &sock): wg_ref{std::move(wg_ref)}, sb{sock},
-				req{&sb}, rs{&sb, sb.out_stat_code, sb.out_hdrs} {}
+			~server_context() = default;
+			server_context(std::shared_ptr<server_connection> const &conn, size_t seq): conn{conn}, sb{*conn, seq},
+				zsb{sb}, req{&sb}, rs{&sb, sb.out_stat_code, sb.out_hdrs} {}
 			server_context(server_context const &) = delete;
 			server_context(server_context &&) = delete;
 			server_context &operator=(server_context const &) = delete;
 			server_context &operator=(server_context &&) = delete;
-			void set_next_context(std::shared_ptr<server_context> const &nc);
-		private:
-			void activate();
+			std::shared_ptr<server_connection> const &connection() const { return conn; }
 		};
 
 		/** @brief HTTP server
@@ -710,9 +1252,14 @@ namespace clane {
 		 * @remark The server instance's serve() method blocks until the server
 		 * terminates, either due to an unrecoverable error or via its terminate()
 		 * method. As such, applications must call serve() within a dedicated
-		 * thread. Internally, the server threading model is naive: it spawns a
-		 * unique thread for each listener, for each connection, and for each
-		 * incoming request. Future versions of @projectname may use fewer threads.
+		 * thread. Internally, the server runs a small, fixed number of event loops
+		 * (see @ref loop_count), each of which accepts connections from every
+		 * listener and receives requests on all of the connections it has
+		 * accepted. Alternatively, each listener may be sharded so that every
+		 * event loop accepts from its own socket (see @ref shard_listeners). The
+		 * server runs root handler invocations on a fixed-size pool
+		 * of worker threads (see @ref handler_threads), so that the server never
+		 * creates a thread per request.
 		 *
 		 * @remark A basic_server is a template based on the handler type.
 		 * @projectname also provides the non-templated @ref server type, which uses
@@ -724,13 +1271,93 @@ namespace clane {
 		 */
 		template <typename Handler> class basic_server {
 			static size_t const default_max_header_size = 8 * 1024;
-			std::deque<clane::net::socket> listeners;
+			static size_t const default_handler_threads = 64;
+			static size_t const default_compression_min_size = 1024;
+			static size_t const any_loop = static_cast<size_t>(-1);
+			struct listener {
+				net::socket sock;
+				size_t shard; // index of the event loop accepting from this socket, or any_loop
+			};
+			std::deque<listener> listeners;
 			clane::net::event term_event;
 			std::deque<std::thread> thrds;
 			clane::sync::wait_group *conn_wg;
+			std::unique_ptr<clane::sync::thread_pool> handler_pool;
 		public:
 			Handler root_handler;
 			size_t max_header_size;
+
+			/** @brief Number of event loops serving connections
+			 *
+			 * @remark Each event loop runs in its own thread and multiplexes all of
+			 * its connections using an edge-triggered net::reactor. The default is
+			 * the number of hardware threads. */
+			size_t loop_count;
+
+			/** @brief Whether to shard each listener across the event loops
+			 *
+			 * @remark If @ref shard_listeners is true then the add_listener()
+			 * method opens one `SO_REUSEPORT` socket per event loop, all bound to
+			 * the same address, and each event loop accepts connections only from
+			 * its own sockets. The kernel then balances incoming connections across
+			 * the event loops, and no two loops contend for the same accept queue.
+			 * Applications must set @ref loop_count before adding listeners in this
+			 * mode. The default is false: every event loop accepts from one shared
+			 * socket per listener. */
+			bool shard_listeners;
+
+			/** @brief Whether to pin each event loop thread to its own CPU
+			 *
+			 * @remark Pinning keeps each event loop, and the connections it
+			 * accepts, on one CPU's caches. It's most useful together with @ref
+			 * shard_listeners. The default is false. */
+			bool pin_loops;
+
+			/** @brief Number of worker threads running root handler invocations
+			 *
+			 * @remark A request whose handler has yet to start waits in a queue
+			 * until a worker thread becomes available. Because a handler may block
+			 * while reading the request body or while waiting for earlier responses
+			 * on the same connection to complete, applications with slow clients
+			 * should allow for more worker threads than hardware threads. */
+			size_t handler_threads;
+
+			/** @brief Maximum number of requests waiting for a worker thread, or
+			 * `0` for no limit
+			 *
+			 * @remark If the queue is full when a new request arrives then the
+			 * server responds with 503 “Service unavailable” and closes the
+			 * connection. */
+			size_t handler_queue_depth;
+
+			/** @brief Stack size, in bytes, of each worker thread, or `0` for the
+			 * platform default */
+			size_t handler_stack_size;
+
+			/** @brief Whether to compress response bodies on the fly
+			 *
+			 * @remark If @ref compress_responses is true then the server
+			 * compresses the body of each successful response that has a
+			 * compressible content type—e.g., `text/html` or `application/json`—if
+			 * the client accepts the gzip or deflate content coding and the body
+			 * is at least @ref compression_min_size bytes long. Compression
+			 * replaces any Content-Length header with chunked transfer coding.
+			 * Responses that set their own Content-Encoding and files sent by
+			 * file_server are sent as is. The default is false. */
+			bool compress_responses;
+
+			/** @brief zlib compression level, from `1` (fastest) to `9` (smallest),
+			 * or `-1` for zlib's default */
+			int compression_level;
+
+			/** @brief Minimum body size, in bytes, to compress
+			 *
+			 * @remark Bodies shorter than this are sent uncompressed unless the
+			 * application flushes the response before finishing. The server
+			 * buffers at most 8 KiB before deciding, so a larger minimum acts as
+			 * 8 KiB. */
+			size_t compression_min_size;
+
 			std::chrono::steady_clock::duration read_timeout;
 			std::chrono::steady_clock::duration write_timeout;
 		public:
@@ -785,15 +1412,35 @@ namespace clane {
 			 * @sa serve() */
 			void terminate();
 
+			/** @brief Returns queueing metrics for the worker threads running root
+			 * handler invocations
+			 *
+			 * @remark The metrics include the time requests spend waiting for a
+			 * worker thread. All metrics are zero until the server starts. */
+			sync::thread_pool::statistics handler_stats();
+
 		private:
-			void listen_main(net::socket &&lis);
-#ifndef CLANE_HAVE_STD_THREAD_MOVE_ARG
-			void listen_main_move_wrapper(std::mutex &lis_mutex, std::condition_variable &lis_cond, net::socket **lis);
-#endif
-			void connection_main(net::socket &&conn);
-#ifndef CLANE_HAVE_STD_THREAD_MOVE_ARG
-			void connection_main_move_wrapper(std::mutex &conn_mutex, std::condition_variable &conn_cond, net::socket **conn);
-#endif
+			typedef std::unordered_map<server_connection *, std::shared_ptr<server_connection>> connection_map;
+			typedef std::deque<std::pair<std::chrono::steady_clock::time_point, std::weak_ptr<server_connection>>> deadline_queue;
+			static size_t const in_capacity = 4096;
+			struct event_loop {
+				net::reactor reactor;
+				connection_map conns;
+				deadline_queue deadlines;
+				server_retire_queue retire_queue;
+				std::shared_ptr<char> inbuf; // receive buffer shared by all of the loop's connections
+				size_t inoff;
+				std::vector<net::socket *> stalled; // listeners with pending connections that couldn't be accepted
+				std::chrono::steady_clock::time_point accept_retry; // when to retry stalled listeners
+				event_loop(): inoff{in_capacity} {}
+			};
+			static size_t default_loop_count();
+			void open_listeners(std::string const &addr);
+			void loop_main(size_t index, size_t count);
+			void accept_all(event_loop &loop, net::socket &lis);
+			bool receive_some(event_loop &loop, std::shared_ptr<server_connection> const &conn);
+			void stop_reading(event_loop &loop, server_connection *conn);
+			void retire(event_loop &loop, server_connection *conn);
 		};
 
 		/** @brief Specializes basic_server for a `std::function` request handler
@@ -822,12 +1469,30 @@ namespace clane {
 
 		template <typename Handler> basic_server<Handler>::basic_server():
 			max_header_size{default_max_header_size},
+			loop_count{default_loop_count()},
+			shard_listeners{},
+			pin_loops{},
+			handler_threads{default_handler_threads},
+			handler_queue_depth{0},
+			handler_stack_size{0},
+			compress_responses{},
+			compression_level{-1},
+			compression_min_size{default_compression_min_size},
 			read_timeout{0},
 			write_timeout{0} {}
 
 		template <typename Handler> basic_server<Handler>::basic_server(Handler &&h):
 			root_handler{std::forward<Handler>(h)},
 			max_header_size{default_max_header_size},
+			loop_count{default_loop_count()},
+			shard_listeners{},
+			pin_loops{},
+			handler_threads{default_handler_threads},
+			handler_queue_depth{0},
+			handler_stack_size{0},
+			compress_responses{},
+			compression_level{-1},
+			compression_min_size{default_compression_min_size},
 			read_timeout{0},
 			write_timeout{0} {}
 
@@ -836,12 +1501,30 @@ namespace clane {
 		template <typename Handler> basic_server<Handler>::basic_server(basic_server &&that) noexcept:
 			root_handler{std::move(that.root_handler)},
 			max_header_size{std::move(that.max_header_size)},
+			loop_count{std::move(that.loop_count)},
+			shard_listeners{std::move(that.shard_listeners)},
+			pin_loops{std::move(that.pin_loops)},
+			handler_threads{std::move(that.handler_threads)},
+			handler_queue_depth{std::move(that.handler_queue_depth)},
+			handler_stack_size{std::move(that.handler_stack_size)},
+			compress_responses{std::move(that.compress_responses)},
+			compression_level{std::move(that.compression_level)},
+			compression_min_size{std::move(that.compression_min_size)},
 			read_timeout{std::move(that.read_timeout)},
 			write_timeout{std::move(that.write_timeout)} {}
 
 		template <typename Handler> basic_server<Handler> &basic_server<Handler>::operator=(basic_server &&that) noexcept {	
 			root_handler = std::move(that.root_handler);
 			max_header_size = std::move(that.max_header_size);
+			loop_count = std::move(that.loop_count);
+			shard_listeners = std::move(that.shard_listeners);
+			pin_loops = std::move(that.pin_loops);
+			handler_threads = std::move(that.handler_threads);
+			handler_queue_depth = std::move(that.handler_queue_depth);
+			handler_stack_size = std::move(that.handler_stack_size);
+			compress_responses = std::move(that.compress_responses);
+			compression_level = std::move(that.compression_level);
+			compression_min_size = std::move(that.compression_min_size);
 			read_timeout = std::move(that.read_timeout);
 			write_timeout = std::move(that.write_timeout);
 			return *this;
@@ -850,226 +1533,324 @@ namespace clane {
 #endif
 
 		template <typename Handler> void basic_server<Handler>::add_listener(char const *addr) {
-			listeners.push_back(listen(&net::tcp, addr));
-			listeners.back().set_nonblocking();
+			open_listeners(addr);
 		}
 
 		template <typename Handler> void basic_server<Handler>::add_listener(std::string const &addr) {
-			listeners.push_back(listen(&net::tcp, addr));
-			listeners.back().set_nonblocking();
+			open_listeners(addr);
 		}
 
 		template <typename Handler> void basic_server<Handler>::add_listener(net::socket &&lis) {
 			lis.set_nonblocking();
-			listeners.push_back(std::move(lis));
+			listeners.push_back(listener{std::move(lis), any_loop});
+		}
+
+		template <typename Handler> void basic_server<Handler>::open_listeners(std::string const &addr) {
+			if (!shard_listeners) {
+				listeners.push_back(listener{listen(&net::tcp, addr), any_loop});
+				listeners.back().sock.set_nonblocking();
+				return;
+			}
+			// Bind the remaining shards to the first shard's address, which has the
+			// actual port number if the given address has none.
+			size_t const n = std::max(static_cast<size_t>(1), loop_count);
+			listeners.push_back(listener{listen(&net::tcp, addr, -1, net::reuse_port), 0});
+			listeners.back().sock.set_nonblocking();
+			std::string const bound_addr = listeners.back().sock.local_address();
+			for (size_t i = 1; i < n; ++i) {
+				listeners.push_back(listener{listen(&net::tcp, bound_addr, -1, net::reuse_port), i});
+				listeners.back().sock.set_nonblocking();
+			}
 		}
 
 		template <typename Handler> void basic_server<Handler>::serve() {
 
+			// The handler pool outlives the connection wait group so that
+			// outstanding handlers may finish.
+			handler_pool.reset(new sync::thread_pool(handler_threads, handler_queue_depth, handler_stack_size));
+
 			sync::wait_group wg; // for waiting on connections to stop
 			conn_wg = &wg;
 
-			// unique thread for each listener:
+			// Every event loop waits on every unsharded listener and on its own
+			// shards of the sharded listeners. The loops share the listeners for the
+			// duration of serving; the reactor wakes only one loop per incoming
+			// connection on an unsharded listener where the platform supports it.
+			size_t const n = std::max(static_cast<size_t>(1), loop_count);
+			for (size_t i = 0; i < n; ++i)
+				thrds.push_back(std::thread(&basic_server::loop_main, this, i, n));
 
-			while (!listeners.empty()) {
-#ifdef CLANE_HAVE_STD_THREAD_MOVE_ARG
-				thrds.push_back(std::thread(&basic_server::listen_main, this, std::move(listeners.front())));
-#else
-				// If std::thread doesn't support rvalue reference arguments then move
-				// the socket inside the thread.
-				net::socket lis = std::move(listeners.front());
-				net::socket *plis = &lis;
-				std::mutex lis_mutex;
-				std::condition_variable lis_cond;
-				std::unique_lock<std::mutex> lis_lock(lis_mutex);
-				thrds.push_back(std::thread(&basic_server::listen_main_move_wrapper, this, std::ref(lis_mutex), std::ref(lis_cond), &plis));
-				while (plis)
-					lis_cond.wait(lis_lock);
-#endif
-				listeners.pop_front();
-			}
-
-			// wait for the termination signal:
-			net::poller poller;
-			poller.add(term_event, poller.in);
-			poller.poll();
-
-			// wait for all listeners to stop:
+			// wait for all event loops to stop, which happens upon termination:
 			for (auto i = thrds.begin(); i != thrds.end(); ++i)
 				i->join();
 			thrds.clear();
+			listeners.clear();
 
 			// The connection wait group will cause this thread to block until
-			// all connection threads have stopped.
+			// all connections have closed.
 		}
 
 		template <typename Handler> void basic_server<Handler>::terminate() {
 			term_event.signal();
 		}
 
-#ifndef CLANE_HAVE_STD_THREAD_MOVE_ARG
-		template <typename Handler> void basic_server<Handler>::listen_main_move_wrapper(std::mutex &lis_mutex,
-		std::condition_variable &lis_cond, net::socket **lis) {
-			std::unique_lock<std::mutex> lis_lock(lis_mutex);
-			net::socket mlis = std::move(**lis);
-			*lis = nullptr;
-			lis_cond.notify_one();
-			lis_lock.unlock();
-			listen_main(std::move(mlis));
+		template <typename Handler> sync::thread_pool::statistics basic_server<Handler>::handler_stats() {
+			if (!handler_pool)
+				return sync::thread_pool::statistics();
+			return handler_pool->stats();
 		}
-#endif
 
-		template <typename Handler> void basic_server<Handler>::listen_main(net::socket &&lis) {
+		template <typename Handler> size_t basic_server<Handler>::default_loop_count() {
+			return std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		template <typename Handler> void basic_server<Handler>::loop_main(size_t index, size_t count) {
+
+			if (pin_loops)
+				sync::pin_thread(index);
+
+			// Connections are owned by the loop that accepted them. Because every
+			// connection in a loop has the same read timeout, the deadline queue
+			// is ordered by expiration.
+			event_loop loop;
+			net::reactor &reactor = loop.reactor;
+			reactor.add(term_event, reactor.in, &term_event);
+			reactor.add(loop.retire_queue.event, reactor.in, &loop.retire_queue.event);
+			std::vector<net::socket *> lis_socks;
+			for (auto i = listeners.begin(); i != listeners.end(); ++i) {
+				if (any_loop == i->shard)
+					reactor.add(i->sock, reactor.in | reactor.exclusive, &i->sock);
+				else if (i->shard % count == index)
+					reactor.add(i->sock, reactor.in, &i->sock);
+				else
+					continue;
+				lis_socks.push_back(&i->sock);
+			}
+
+			// Once terminating, the loop stops accepting connections and stops
+			// receiving requests but keeps running until all of its connections
+			// have finished sending their responses.
+			bool terminating = false;
+
+			static size_t const max_events = 64;
+			net::reactor_event evs[max_events];
+			while (!terminating || !loop.conns.empty()) {
+
+				// stop reading from connections whose read timeout has elapsed:
+				auto now = std::chrono::steady_clock::now();
+				while (!loop.deadlines.empty() && (loop.deadlines.front().first <= now ||
+				loop.deadlines.front().second.expired())) {
+					auto conn = loop.deadlines.front().second.lock();
+					loop.deadlines.pop_front();
+					if (!conn)
+						continue; // already closed
+					// FIXME: timeout
+					stop_reading(loop, conn.get());
+				}
 
-			net::poller poller;
-			size_t const iterm = poller.add(term_event, poller.in);
-			poller.add(lis, poller.in);
+				// retry listeners that ran out of descriptors:
+				if (!loop.stalled.empty() && loop.accept_retry <= now) {
+					std::vector<net::socket *> stalled;
+					stalled.swap(loop.stalled);
+					for (auto j = stalled.begin(); j != stalled.end(); ++j)
+						accept_all(loop, **j);
+				}
+
+				// wait for events: data, writability, new connections, finished
+				// responses, termination, or timeout
+				size_t n;
+				if (!loop.stalled.empty())
+					n = reactor.wait(evs, max_events, loop.deadlines.empty() ? loop.accept_retry :
+						std::min(loop.accept_retry, loop.deadlines.front().first));
+				else if (!loop.deadlines.empty())
+					n = reactor.wait(evs, max_events, loop.deadlines.front().first);
+				else
+					n = reactor.wait(evs, max_events);
+
+				for (size_t i = 0; i < n; ++i) {
+					if (evs[i].data == &term_event) {
+						if (terminating)
+							continue;
+						terminating = true;
+						for (auto j = lis_socks.begin(); j != lis_socks.end(); ++j)
+							reactor.remove(**j);
+						loop.stalled.clear();
+						std::vector<server_connection *> all;
+						for (auto j = loop.conns.begin(); j != loop.conns.end(); ++j)
+							all.push_back(j->first);
+						for (auto j = all.begin(); j != all.end(); ++j)
+							stop_reading(loop, *j);
+						continue;
+					}
+					if (evs[i].data == &loop.retire_queue.event) {
+						loop.retire_queue.event.reset();
+						std::vector<server_connection *> ready = loop.retire_queue.take();
+						for (auto j = ready.begin(); j != ready.end(); ++j)
+							retire(loop, *j);
+						continue;
+					}
+					auto lis = std::find(lis_socks.begin(), lis_socks.end(), evs[i].data);
+					if (lis != lis_socks.end()) {
+						if (!terminating)
+							accept_all(loop, **lis);
+						continue;
+					}
+					auto p = loop.conns.find(static_cast<server_connection *>(evs[i].data));
+					if (p == loop.conns.end())
+						continue; // closed earlier in this batch
+					server_connection *conn = p->first;
+					if (evs[i].events & reactor.out)
+						conn->drain();
+					if (conn->is_reading()) {
+						if ((evs[i].events & (reactor.in | reactor.error | reactor.hangup)) && !receive_some(loop, p->second))
+							stop_reading(loop, conn);
+					} else {
+						retire(loop, conn);
+					}
+				}
+			}
+		}
 
-			// accept incoming connections, and launch a unique thread for each new
-			// connection:
-			auto poll_res = poller.poll();
-			while (poll_res.index != iterm) {
+		template <typename Handler> void basic_server<Handler>::accept_all(event_loop &loop, net::socket &lis) {
+
+			// The listener is edge-triggered, so accept until there are no more
+			// pending connections.
+			while (true) {
 				std::error_code e;
-				net::socket conn = lis.accept(e);
+				net::socket sock = lis.accept(e);
+				if (e == std::errc::operation_would_block || e == std::errc::resource_unavailable_try_again)
+					return; // no more connections
+				if (e == std::errc::too_many_files_open || e == std::errc::too_many_files_open_in_system ||
+					e == std::errc::no_buffer_space || e == std::errc::not_enough_memory) {
+					// Connections are still pending, but the listener won't signal again
+					// until another one arrives, so retry after other connections have
+					// had a chance to close.
+					if (loop.stalled.empty())
+						loop.accept_retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+					if (std::find(loop.stalled.begin(), loop.stalled.end(), &lis) == loop.stalled.end())
+						loop.stalled.push_back(&lis);
+					return;
+				}
 				if (e)
-					continue; // ignore error
-#ifdef CLANE_HAVE_STD_THREAD_MOVE_ARG
-				std::thread conn_thrd(&basic_server::connection_main, this, std::move(conn));
-#else
-				// If std::thread doesn't support rvalue reference arguments then move
-				// the socket inside the thread.
-				net::socket *pconn = &conn;
-				std::mutex conn_mutex;
-				std::condition_variable conn_cond;
-				std::unique_lock<std::mutex> conn_lock(conn_mutex);
-				std::thread conn_thrd(&basic_server::connection_main_move_wrapper, this, std::ref(conn_mutex), std::ref(conn_cond), &pconn);
-				while (pconn)
-					conn_cond.wait(conn_lock);
-#endif
-				conn_thrd.detach();
-				poll_res = poller.poll();
+					continue; // the pending connection failed--ignore it
+				sock.set_nonblocking();
+				auto conn = std::make_shared<server_connection>(conn_wg->new_reference(), loop.retire_queue, std::move(sock));
+				loop.reactor.add(conn->sock, loop.reactor.in | loop.reactor.out, conn.get());
+				if (std::chrono::steady_clock::duration::zero() != read_timeout)
+					loop.deadlines.push_back(std::make_pair(std::chrono::steady_clock::now() + read_timeout, conn));
+				loop.conns[conn.get()] = std::move(conn);
 			}
 		}
 
-#ifndef CLANE_HAVE_STD_THREAD_MOVE_ARG
-		template <typename Handler> void basic_server<Handler>::connection_main_move_wrapper(std::mutex &conn_mutex,
-		std::condition_variable &conn_cond, net::socket **conn) {
-			std::unique_lock<std::mutex> conn_lock(conn_mutex);
-			net::socket mconn = std::move(**conn);
-			*conn = nullptr;
-			conn_cond.notify_one();
-			conn_lock.unlock();
-			connection_main(std::move(mconn));
+		template <typename Handler> void basic_server<Handler>::stop_reading(event_loop &loop, server_connection *conn) {
+			conn->stop_reading();
+			retire(loop, conn);
+		}
+
+		template <typename Handler> void basic_server<Handler>::retire(event_loop &loop, server_connection *conn) {
+			auto p = loop.conns.find(conn);
+			if (p == loop.conns.end() || !p->second->retirable())
+				return; // already closed, or responses are outstanding
+			loop.reactor.remove(p->second->sock);
+			loop.conns.erase(p);
 		}
-#endif
 
 		template <typename Handler> void handler_main(Handler &h, std::shared_ptr<server_context> ctx) {
 			h(ctx->rs, ctx->req);
+			ctx->zsb.finish();
+			ctx->sb.finish();
 		}
 
-		template <typename Handler> void basic_server<Handler>::connection_main(net::socket &&conn) {
-
-			auto my_ref = conn_wg->new_reference();
-			sync::wait_group req_wg; // for waiting on request-handler threads to complete
-
-			conn.set_nonblocking();
-
-			// input buffer:
-			static size_t const incap = 4096;
-			std::shared_ptr<char> inbuf;
-			size_t inoff = incap;
-			size_t insiz;
+		template <typename Handler> bool basic_server<Handler>::receive_some(event_loop &loop,
+		std::shared_ptr<server_connection> const &conn_ptr) {
 
-			// request-handler context:
-			auto cur_ctx = std::make_shared<server_context>(req_wg.new_reference(), conn);
+			server_connection &conn = *conn_ptr;
 
-			// parsing:
-			v1x_request_incparser pars;
-			pars.reset();
-			pars.set_length_limit(max_header_size);
-			bool got_hdrs = false;
-
-			// I/O multiplexing:
-			std::chrono::steady_clock::time_point to;
-			if (std::chrono::steady_clock::duration::zero() != read_timeout)
-				to = std::chrono::steady_clock::now() + read_timeout;
-			net::poller poller;
-			size_t const iterm = poller.add(term_event, poller.in);
-			poller.add(conn, poller.in);
-
-			// consume incoming data from the connection:
+			// The connection is edge-triggered, so consume incoming data until the
+			// connection would block.
 			while (true) {
 
-				// wait for event: data, termination, or timeout
-				auto poll_res = std::chrono::steady_clock::duration::zero() == to.time_since_epoch() ? poller.poll() : poller.poll(to);
-				if (!poll_res.index) {
-					// FIXME: timeout
-					goto done;
-				}
-				if (poll_res.index == iterm) {
-					// FIXME: termination
-					goto done;
-				}
-
-				// reallocate input buffer if full:
-				if (inoff == incap) {
-					inbuf = std::unique_ptr<char, std::default_delete<char[]>>(new char[incap]);
-					inoff = insiz = 0;
+				// Reuse the input buffer from the start if no request body refers to
+				// it, or else reallocate it if full.
+				if (1 == loop.inbuf.use_count()) {
+					loop.inoff = 0;
+				} else if (loop.inoff == in_capacity) {
+					loop.inbuf = std::unique_ptr<char, std::default_delete<char[]>>(new char[in_capacity]);
+					loop.inoff = 0;
 				}
 
 				// receive:
+				size_t insiz;
 				{
 					std::error_code e;
-					size_t xstat = conn.recv(reinterpret_cast<char *>(inbuf.get()) + inoff, incap - inoff, e);
+					insiz = conn.sock.recv(loop.inbuf.get() + loop.inoff, in_capacity - loop.inoff, e);
 					if (e == std::errc::operation_would_block || e == std::errc::resource_unavailable_try_again)
-						continue; // go back to waiting
+						return true; // go back to waiting
 					if (e) {
 						// FIXME: connection error
-						goto done;
+						return false;
 					}
-					if (!xstat) {
+					if (!insiz) {
 						// FIXME: connection FIN
-						goto done;
+						return false;
 					}
-					insiz = xstat;
 				}
 
 				// process the received data:
 				while (insiz) {
 
+					// The parser exists only while a request is in progress.
+					if (!conn.pars) {
+						conn.pars.reset(new v1x_request_incparser);
+						conn.pars->reset();
+						conn.pars->set_length_limit(max_header_size);
+					}
+
 					// parse:
-					size_t pstat = pars.parse_some(inbuf.get()+inoff, inbuf.get()+inoff+insiz);
+					v1x_request_incparser &pars = *conn.pars;
+					size_t pstat = pars.parse_some(loop.inbuf.get()+loop.inoff, loop.inbuf.get()+loop.inoff+insiz);
 					if (pars.error == pstat) {
 						// FIXME: error
-						goto done;
+						return false;
 					}
 
 					// FIXME: check HTTP version
 
+					std::shared_ptr<server_context> &cur_ctx = conn.cur_ctx;
 					if (pars.got_headers()) {
 
 						// got new request?
-						if (!got_hdrs) {
+						if (!cur_ctx) {
 
 							// set up request object:
-							got_hdrs = true;
+							cur_ctx = std::make_shared<server_context>(conn_ptr, conn.begin_response());
 							cur_ctx->sb.enable();
 							cur_ctx->req.method = std::move(pars.method());
+							cur_ctx->req.method_id = pars.method_id();
 							cur_ctx->req.uri = std::move(pars.uri());
 							cur_ctx->req.major_version = pars.major_version();
 							cur_ctx->req.minor_version = pars.minor_version();
 							cur_ctx->sb.set_version(cur_ctx->req.major_version, cur_ctx->req.minor_version);
 							cur_ctx->req.headers = std::move(pars.headers());
-
-							// start request handler:
-							std::thread(&handler_main<Handler>, std::ref(root_handler), cur_ctx).detach();
+							if (compress_responses) {
+								cur_ctx->zsb.enable(cur_ctx->req.headers, compression_level, compression_min_size);
+								cur_ctx->rs.rdbuf(&cur_ctx->zsb);
+							}
+
+							// queue request handler:
+							if (!handler_pool->submit(std::bind(&handler_main<Handler>, std::ref(root_handler), cur_ctx))) {
+								// All worker threads are busy and the queue is full. Reject the
+								// request and stop reading from the connection.
+								cur_ctx->sb.reject(status_code::service_unavailable);
+								return false;
+							}
 						}
 
 						// feed body data to request object:
-						cur_ctx->sb.more_request_body(inbuf, inoff+pars.offset(), pars.size());
+						cur_ctx->sb.more_request_body(loop.inbuf, loop.inoff+pars.offset(), pars.size());
 					}
 
-					inoff += pstat;
+					loop.inoff += pstat;
 					insiz -= pstat;
 
 					if (pars)
@@ -1078,19 +1859,10 @@ namespace clane {
 					// request is complete:
 					cur_ctx->req.trailers = std::move(pars.trailers());
 					cur_ctx->sb.end_request_body();
-
-					// prepare for next request:
-					{
-						auto next_ctx = std::make_shared<server_context>(req_wg.new_reference(), conn);
-						cur_ctx->set_next_context(next_ctx); // set up pipeline dependency
-						cur_ctx = std::move(next_ctx);
-						pars.reset();
-						got_hdrs = false;
-					}
+					cur_ctx.reset();
+					conn.pars.reset();
 				}
 			}
-done: // connection is finished, regardless whether graceful or not
-			{}
 		}
 
 	}
@@ -14,11 +14,169 @@
 #include "clane_base_pub.hpp"
 #include "clane_http_pub.hpp"
 #include "clane_regex.hpp"
-#include <list>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace clane {
 	namespace http {
 
+		// Literal equivalent of a route criterion's regular expression, for
+		// criteria simple enough to match without running the regular expression.
+		// For example, "^/users$" matches exactly "/users", "^/static/" matches
+		// any path with the prefix "/static/", and the empty pattern matches
+		// everything.
+		struct route_literal {
+			enum kind_type {
+				none, // needs the regular expression
+				prefix,
+				exact,
+				substring // from a pattern with the literal syntax option
+			};
+			kind_type kind;
+			std::string text;
+		};
+
+		route_literal analyze_route_pattern(std::string const &pattern, regex::options_type reopts);
+
+		// Returns true if a string may be matched against a route_literal in place
+		// of the regular expression. A Perl-syntax anchor also matches at a line
+		// separator, so strings containing control characters or non-ASCII bytes
+		// must use the regular expression.
+		bool is_route_literal_safe(std::string const &s);
+
+		// Route path pattern containing "{name}" parameters. Each parameter
+		// matches a nonempty run of characters other than '/', and the rest of
+		// the pattern is a regular expression. If the pattern is anchored, its
+		// text is otherwise literal, and each parameter ends a path segment,
+		// then the template matches without running the regular expression.
+		struct route_path_template {
+			std::vector<std::string> names; // in order of appearance
+			std::string regex; // pattern with each parameter as a named capture group
+			bool literal;
+			bool exact; // if literal: whether the pattern ends with "$"
+			std::vector<std::string> texts; // if literal: text before each parameter, then any trailing text
+		};
+
+		// Parses the parameters of a route path pattern, returning false if the
+		// pattern has none.
+		bool parse_route_path_template(std::string const &pattern, route_path_template *t);
+
+		// Matches a request path against a route path, appending any captured
+		// parameters to *params, if not null. The template is used if it has
+		// parameters; otherwise, the literal or regular expression is.
+		bool match_route_path(std::string const &path, boost::regex const &re, route_literal const &lit,
+			route_path_template const &t, std::vector<path_param> *params);
+
+		// Returns the set of methods that may match a route method pattern. If
+		// the pattern is an anchored standard method or a grouped, anchored
+		// alternation of standard methods--e.g., "^GET$", "^(GET|HEAD)$", or
+		// "^(?:GET|HEAD)$"--then the set alone decides the match and *exact is
+		// set to true. Otherwise, the regular expression decides the
+		// match among the methods in the set.
+		method_set analyze_method_pattern(std::string const &pattern, regex::options_type reopts, bool *exact);
+
+		inline bool match_route_criterion(std::string const &s, boost::regex const &re, route_literal const &lit) {
+			switch (lit.kind) {
+				case route_literal::prefix:
+					if (is_route_literal_safe(s))
+						return !s.compare(0, lit.text.size(), lit.text);
+					break;
+				case route_literal::exact:
+					if (is_route_literal_safe(s))
+						return s == lit.text;
+					break;
+				case route_literal::substring:
+					return std::string::npos != s.find(lit.text);
+				default:
+					break;
+			}
+			return boost::regex_search(s, re);
+		}
+
+		// Index of a router's routes, for finding the few routes that may match a
+		// request without trying every route in turn. The index holds a radix tree
+		// of literal route paths for each method bit, into which go the routes
+		// whose method set contains that bit. Each node of a tree lists, in route order, every route
+		// that may match a path ending at or passing through the node: routes
+		// with a prefix or exact path at the node, routes with a prefix path at
+		// an ancestor, and routes whose path needs a regular expression.
+		class route_index {
+			struct node {
+				std::string label; // edge label from the parent node
+				std::vector<std::unique_ptr<node>> children; // in order of first label character
+				std::vector<size_t> prefix_routes;
+				std::vector<size_t> exact_routes;
+				std::vector<size_t> passing; // candidates for paths extending past the node
+				std::vector<size_t> ending; // candidates for paths ending at the node
+			};
+			struct tree {
+				node root;
+				std::vector<size_t> other_routes; // routes with a non-literal path
+			};
+			static size_t const method_count = 10; // bits in method_any
+			tree by_method[method_count];
+		public:
+			void add(size_t route, method_set methods, route_literal const &path);
+			void finish();
+			std::vector<size_t> const *find(method_set method_id, std::string const &path) const;
+		private:
+			static void add(tree &t, size_t route, route_literal const &path);
+			static void finish(node &n, std::vector<size_t> const &inherited);
+		};
+
+		// Bounded cache of a router's matching results, keyed by request method,
+		// host, and path. The cache is a direct-mapped table split into shards,
+		// each with its own lock, so that concurrent lookups seldom contend. A
+		// new entry replaces whatever entry had its slot.
+		class route_match_cache {
+			struct cached_param {
+				std::string name;
+				size_t pos;
+				size_t size;
+			};
+			struct slot {
+				bool used;
+				std::string method;
+				std::string host;
+				std::string path;
+				size_t route;
+				std::vector<cached_param> params;
+				slot(): used(false), route() {}
+			};
+			struct shard {
+				std::mutex mutex;
+				std::vector<slot> slots;
+				size_t hits;
+				size_t misses;
+			};
+			static size_t const shard_count = 16;
+			shard shards[shard_count];
+		public:
+			static size_t const no_route = static_cast<size_t>(-1);
+			explicit route_match_cache(size_t capacity);
+			route_match_cache(route_match_cache const &) = delete;
+			route_match_cache &operator=(route_match_cache const &) = delete;
+
+			// Looks up the route for a request. On a hit, appends to *params the
+			// path parameters that the route captured, as views into path.
+			bool find(std::string const &method, std::string const &host, std::string const &path, size_t *route,
+				std::vector<path_param> *params);
+
+			// Records the route for a request, along with the path parameters that
+			// the route captured--i.e., params[first_param] onwards.
+			void insert(std::string const &method, std::string const &host, std::string const &path, size_t route,
+				std::vector<path_param> const &params, size_t first_param);
+
+			void clear();
+			size_t hits();
+			size_t misses();
+		private:
+			shard &locate(std::string const &method, std::string const &host, std::string const &path, slot **sl);
+		};
+
 		/** @brief Matches HTTP requests against a set of criteria
 		 *
 		 * @remark The basic_route class pairs (1) a set of criteria with which
@@ -31,12 +189,22 @@ namespace clane {
 		 * @remark A route may contain any of the following criteria:
 		 *
 		 * @remark
-		 * - **Method.** The route method is a regular expression string. Any
-		 *   matching request must have a status line _method_ field that
-		 *   matches the route method regular expression.
+		 * - **Method.** The route method is either a set of standard methods,
+		 *   e.g., `http::method_get | http::method_head`, or a regular
+		 *   expression string. Any matching request must have a request line
+		 *   _method_ field that is in the route method set or that matches the
+		 *   route method regular expression. A regular expression that is an
+		 *   anchored alternation of standard methods, e.g., `"^(GET|HEAD)$"`,
+		 *   costs no more than the equivalent method set; other regular
+		 *   expressions are for matching extension methods.
 		 * - **Path.** The route path is a regular expression string. Any
 		 *   matching request must have a status line URI _path_ component that
-		 *   matches the route path regular expression.
+		 *   matches the route path regular expression. The route path may
+		 *   contain parameters of the form `{name}`, each of which matches one
+		 *   nonempty path segment—e.g., `"^/users/{id}/posts/{post}$"`. When
+		 *   the route matches, it attaches the parameters to the request as
+		 *   @link request::path_params path_params@endlink, so that request
+		 *   handlers needn't parse the path again.
 		 * - **Headers.** The route headers are a map of name–value pairs,
 		 *   whereby each name is a literal string and each value is a regular
 		 *   expression string. Any matching request must have, for each header
@@ -55,6 +223,11 @@ namespace clane {
 			Handler h;
 			boost::regex method_;
 			boost::regex path_;
+			method_set methods_; // methods that may match
+			bool method_re_; // whether the method must also match method_
+			route_literal method_lit_;
+			route_literal path_lit_;
+			route_path_template path_tmpl_;
 			header_match_map hdrs_;
 		public:
 			~basic_route() {}
@@ -78,24 +251,41 @@ namespace clane {
 			// TODO: Replace the handle() method with handler() accessor
 			// methods.
 			void handle(response_ostream &rs, request &req) { h(rs, req); }
-			bool match(request const &req) const;
+			bool match(request const &req) const { return match(req, nullptr); }
+			bool match(request &req) const { return match(req, &req.path_params); }
+			method_set methods() const { return methods_; }
+			bool depends_on_headers() const;
+			route_literal const &path_literal() const { return path_lit_; }
 
 			// criteria:
+			basic_route &method(method_set m);
 			template <typename Source> basic_route &method(Source s, regex::options_type reopts = regex::options::normal);
 			template <typename Source> basic_route &host(Source s, regex::options_type reopts = regex::options::normal);
 			template <typename Source> basic_route &path(Source s, regex::options_type reopts = regex::options::normal);
 			template <typename Source1, typename Source2> basic_route &
 			header(Source1 name, Source2 value, regex::options_type reopts = regex::options::normal);
+		private:
+			bool match(request const &req, std::vector<path_param> *params) const;
 		};
 
 		template <typename Handler> basic_route<Handler>::basic_route():
 			method_(""),
-			path_("") {}
+			path_(""),
+			methods_(method_any),
+			method_re_(false),
+			method_lit_{route_literal::prefix, std::string()},
+			path_lit_{route_literal::prefix, std::string()},
+			path_tmpl_() {}
 
 		template <typename Handler> basic_route<Handler>::basic_route(Handler &&h):
 			h(std::forward<Handler>(h)),
 			method_(""),
-			path_("") {}
+			path_(""),
+			methods_(method_any),
+			method_re_(false),
+			method_lit_{route_literal::prefix, std::string()},
+			path_lit_{route_literal::prefix, std::string()},
+			path_tmpl_() {}
 
 #ifdef CLANE_HAVE_NO_DEFAULT_MOVE
 
@@ -103,6 +293,11 @@ namespace clane {
 			h(std::move(that.h)),
 		 	method_(std::move(that.method_)),
 			path_(std::move(that.path_)),
+			methods_(that.methods_),
+			method_re_(that.method_re_),
+			method_lit_(std::move(that.method_lit_)),
+			path_lit_(std::move(that.path_lit_)),
+			path_tmpl_(std::move(that.path_tmpl_)),
 			hdrs_(std::move(that.hdrs_)) {}
 
 		template <typename Handler> basic_route<Handler> &
@@ -110,6 +305,11 @@ namespace clane {
 			h = std::move(that.h);
 			method_ = std::move(that.method_);
 			path_ = std::move(that.path_);
+			methods_ = that.methods_;
+			method_re_ = that.method_re_;
+			method_lit_ = std::move(that.method_lit_);
+			path_lit_ = std::move(that.path_lit_);
+			path_tmpl_ = std::move(that.path_tmpl_);
 			hdrs_ = std::move(that.hdrs_);
 		 	return *this;
 		}
@@ -120,17 +320,41 @@ namespace clane {
 			std::swap(h, that.h);
 			std::swap(method_, that.method_);
 			std::swap(path_, that.path_);
+			std::swap(methods_, that.methods_);
+			std::swap(method_re_, that.method_re_);
+			std::swap(method_lit_, that.method_lit_);
+			std::swap(path_lit_, that.path_lit_);
+			std::swap(path_tmpl_, that.path_tmpl_);
+			std::swap(hdrs_, that.hdrs_);
 		}
 
-		template <typename Handler> bool basic_route<Handler>::match(request const &req) const {
+		template <typename Handler> bool basic_route<Handler>::depends_on_headers() const {
+			for (auto i = hdrs_.begin(); i != hdrs_.end(); ++i) {
+				if (ascii::icase_compare(i->first, "host"))
+					return true;
+			}
+			return false;
+		}
+
+		template <typename Handler> bool basic_route<Handler>::match(request const &req,
+		std::vector<path_param> *params) const {
 
 			// TODO: Should regular expression matching be "match" instead of
 			// "search"?
 
-			if (!boost::regex_search(req.method, method_) ||
-			    !boost::regex_search(req.uri.path, path_))
+			if (!(methods_ & request_method_id(req)) ||
+			    (method_re_ && !match_route_criterion(req.method, method_, method_lit_)))
 				return false;
 
+			// A match captures path parameters, but a mismatch mustn't leave any
+			// behind.
+			size_t const old_params = params ? params->size() : 0;
+			if (!match_route_path(req.uri.path, path_, path_lit_, path_tmpl_, params)) {
+				if (params)
+					params->resize(old_params);
+				return false;
+			}
+
 			// every header match item must match at least one header:
 			// The name must match as normal--literally, case-insensitive. The value
 			// matches as a regular expression.
@@ -140,6 +364,8 @@ namespace clane {
 					if (boost::regex_search(j->second, i->second))
 						goto next_header_match_item;
 				}
+				if (params)
+					params->resize(old_params);
 				return false;
 next_header_match_item:
 				continue;
@@ -147,9 +373,21 @@ next_header_match_item:
 			return true;
 		}
 
+		template <typename Handler> basic_route<Handler> &basic_route<Handler>::method(method_set m) {
+			method_.assign("");
+			methods_ = m;
+			method_re_ = false;
+			method_lit_ = route_literal{route_literal::prefix, std::string()};
+			return *this;
+		}
+
 		template <typename Handler> template <typename Source> basic_route<Handler> &
 		basic_route<Handler>::method(Source s, regex::options_type reopts) {
 			method_.assign(s, regex::boost_regex_option(reopts));
+			bool exact;
+			methods_ = analyze_method_pattern(method_.str(), reopts, &exact);
+			method_re_ = !exact;
+			method_lit_ = analyze_route_pattern(method_.str(), reopts);
 			return *this;
 		}
 
@@ -168,7 +406,17 @@ next_header_match_item:
 
 		template <typename Handler> template <typename Source> basic_route<Handler> &
 		basic_route<Handler>::path(Source s, regex::options_type reopts) {
-			path_.assign(s, regex::boost_regex_option(reopts));
+			std::string const pattern(s);
+			route_path_template t{};
+			if (regex::options::literal != reopts && parse_route_path_template(pattern, &t)) {
+				path_.assign(t.regex, regex::boost_regex_option(reopts));
+				path_lit_ = t.literal ? route_literal{route_literal::prefix, t.texts[0]} :
+					route_literal{route_literal::none, std::string()};
+			} else {
+				path_.assign(pattern, regex::boost_regex_option(reopts));
+				path_lit_ = analyze_route_pattern(pattern, reopts);
+			}
+			path_tmpl_ = std::move(t);
 			return *this;
 		}
 
@@ -193,12 +441,46 @@ next_header_match_item:
 		}
 
 		/** @brief HTTP request handler that dispatches requests to one of many
-		 * given request handlers according to specified criteria */
+		 * given request handlers according to specified criteria
+		 *
+		 * @remark A router dispatches each request to the first of its routes
+		 * that matches the request. Rather than trying every route in turn, the
+		 * router indexes routes by method and path so that it need only try the
+		 * routes that may match. A route whose method is a method set, or whose
+		 * path is an anchored literal—e.g., `"^/users$"` or the prefix
+		 * `"^/static/"`—costs nothing to skip; only routes whose criteria need
+		 * regular expressions are tried for every request.
+		 *
+		 * @remark When the router dispatches a request to a route whose path has
+		 * `{name}` parameters, the request's @link request::path_params
+		 * path_params@endlink member holds the parameters that the route
+		 * captured.
+		 *
+		 * @remark Optionally, the router also caches the route that matched each
+		 * recent combination of method, host, and path, so that a repeat request
+		 * skips route matching entirely. Only routes whose criteria don't
+		 * include headers other than the host are cacheable, and a request is
+		 * cached only if it has exactly one Host header and every route tried
+		 * before the matching route is cacheable, too. The cache is disabled by
+		 * default; see
+		 * set_match_cache_capacity().
+		 *
+		 * @remark The router builds its index when it dispatches its first
+		 * request after a call to new_route() or clear(). Applications must finish
+		 * setting up each route's criteria before then. */
 		template <typename Handler> class basic_router {
-			std::list<std::unique_ptr<basic_route<Handler>>> routes;
+			struct index_state {
+				std::mutex mutex;
+				std::atomic<route_index const *> index;
+				std::unique_ptr<route_index> owned;
+				index_state(): index(nullptr) {}
+			};
+			std::vector<std::unique_ptr<basic_route<Handler>>> routes;
+			std::unique_ptr<index_state> idx;
+			std::unique_ptr<route_match_cache> cache;
 		public:
 			~basic_router() {}
-			basic_router() {}
+			basic_router(): idx{new index_state} {}
 			basic_router(basic_router const &) = default;
 			basic_router &operator=(basic_router const &) = default;
 #ifndef CLANE_HAVE_NO_DEFAULT_MOVE
@@ -212,42 +494,386 @@ next_header_match_item:
 			void swap(basic_router &that) noexcept;
 			void operator()(response_ostream &rs, request &req);
 
-			void clear() { routes.clear(); }
+			void clear() { routes.clear(); invalidate(); }
 
 			basic_route<Handler> &new_route(Handler const &h);
 			basic_route<Handler> &new_route(Handler &&h);
+
+			/** @brief Builds the router's index now rather than when dispatching
+			 * the next request */
+			void compile() { index(); }
+
+			/** @brief Enables or disables the route match cache
+			 *
+			 * @remark The router caches the matching route for up to @p capacity
+			 * combinations of method, host, and path. A capacity of zero, the
+			 * default, disables the cache. Applications mustn't call this method
+			 * while the router is dispatching requests. */
+			void set_match_cache_capacity(size_t capacity);
+
+			/** @brief Returns the number of requests dispatched using the route
+			 * match cache */
+			size_t match_cache_hits() const { return cache ? cache->hits() : 0; }
+
+			/** @brief Returns the number of requests not found in the route match
+			 * cache */
+			size_t match_cache_misses() const { return cache ? cache->misses() : 0; }
+		private:
+			route_index const *index();
+			void invalidate();
+			bool try_route(response_ostream &rs, request &req, size_t i, std::string const *host, bool *cacheable);
 		};
 
 		template <typename Handler> void basic_router<Handler>::swap(basic_router &that) noexcept {
 			std::swap(routes, that.routes);
+			std::swap(idx, that.idx);
+			std::swap(cache, that.cache);
 		}
 
 		template <typename Handler> void basic_router<Handler>::operator()(response_ostream &rs, request &req) {
 
-			// search for matching route:
-			for (auto i = routes.begin(); i != routes.end(); ++i) {
-				if ((*i)->match(req)) {
-					(*i)->handle(rs, req);
+			// Look up the request in the cache, if any. Only a request with exactly
+			// one Host header is cached: a missing Host header and an empty one
+			// match routes differently but would share the same key.
+			std::string const *host = nullptr;
+			if (cache) {
+				auto r = req.headers.equal_range(header_id::host);
+				if (r.first != r.second && std::next(r.first) == r.second)
+					host = &r.first->second;
+			}
+			if (host) {
+				size_t cached;
+				if (cache->find(req.method, *host, req.uri.path, &cached, &req.path_params)) {
+					if (route_match_cache::no_route == cached)
+						rs.status = status_code::not_found;
+					else
+						routes[cached]->handle(rs, req);
 					return;
 				}
 			}
+			bool cacheable = nullptr != host;
+
+			// search for matching route, trying only the routes that the index
+			// says may match, if possible:
+			route_index const *index = this->index();
+			std::vector<size_t> const *candidates = index ? index->find(request_method_id(req), req.uri.path) : nullptr;
+			if (candidates) {
+				for (auto i = candidates->begin(); i != candidates->end(); ++i) {
+					if (try_route(rs, req, *i, host, &cacheable))
+						return;
+				}
+			} else {
+				for (size_t i = 0; i < routes.size(); ++i) {
+					if (try_route(rs, req, i, host, &cacheable))
+						return;
+				}
+			}
 
 			// no matching route:
+			if (cacheable)
+				cache->insert(req.method, *host, req.uri.path, route_match_cache::no_route, req.path_params,
+					req.path_params.size());
 			rs.status = status_code::not_found;
 		}
 
+		template <typename Handler> bool basic_router<Handler>::try_route(response_ostream &rs, request &req, size_t i,
+		std::string const *host, bool *cacheable) {
+			basic_route<Handler> &route = *routes[i];
+			*cacheable = *cacheable && !route.depends_on_headers();
+			size_t const first_param = req.path_params.size();
+			if (!route.match(req))
+				return false;
+			if (*cacheable)
+				cache->insert(req.method, *host, req.uri.path, i, req.path_params, first_param);
+			route.handle(rs, req);
+			return true;
+		}
+
+		template <typename Handler> void basic_router<Handler>::set_match_cache_capacity(size_t capacity) {
+			cache.reset(capacity ? new route_match_cache(capacity) : nullptr);
+		}
+
 		template <typename Handler> basic_route<Handler> &basic_router<Handler>::new_route(Handler const &h) {
+			invalidate();
 			routes.push_back(std::unique_ptr<basic_route<Handler>>(new basic_route<Handler>(h)));
 			return *routes.back().get();
 		}
 
 		template <typename Handler> basic_route<Handler> &basic_router<Handler>::new_route(Handler &&h) {
+			invalidate();
 			routes.push_back(std::unique_ptr<basic_route<Handler>>(new basic_route<Handler>(std::move(h))));
 			return *routes.back().get();
 		}
 
+		template <typename Handler> route_index const *basic_router<Handler>::index() {
+			if (!idx)
+				return nullptr; // moved from
+			route_index const *p = idx->index.load(std::memory_order_acquire);
+			if (p)
+				return p;
+			std::lock_guard<std::mutex> lock(idx->mutex);
+			if (!idx->owned) {
+				std::unique_ptr<route_index> built(new route_index);
+				for (size_t i = 0; i < routes.size(); ++i)
+					built->add(i, routes[i]->methods(), routes[i]->path_literal());
+				built->finish();
+				idx->owned = std::move(built);
+				idx->index.store(idx->owned.get(), std::memory_order_release);
+			}
+			return idx->owned.get();
+		}
+
+		template <typename Handler> void basic_router<Handler>::invalidate() {
+			// Changing routes while dispatching requests isn't supported, so there's
+			// no reader to race with.
+			if (!idx)
+				idx.reset(new index_state);
+			idx->index.store(nullptr, std::memory_order_release);
+			idx->owned.reset();
+			if (cache)
+				cache->clear();
+		}
+
 		/** @brief Specializes basic_router for a `std::function` request handler */
 		typedef basic_router<std::function<void(response_ostream &, request &)>> router;
+
+		// Tracks readers that are between loading a shared pointer and taking a
+		// reference to the object it points to, so that a writer that has
+		// replaced the pointer may wait until no reader can still be taking a
+		// reference to the old object. Readers use one of two counters, chosen
+		// by a parity that the writer flips before waiting for the other counter
+		// to drain, so that new readers can't keep the writer waiting. The
+		// writer waits for both counters because a reader may choose its counter
+		// just before a flip.
+		class reader_window {
+			std::atomic<unsigned> parity;
+			std::atomic<size_t> counts[2];
+		public:
+			reader_window();
+			reader_window(reader_window const &) = delete;
+			reader_window &operator=(reader_window const &) = delete;
+			unsigned enter();
+			void leave(unsigned ticket);
+			void synchronize();
+		};
+
+		inline unsigned reader_window::enter() {
+			unsigned const ticket = parity.load() & 1;
+			counts[ticket].fetch_add(1);
+			return ticket;
+		}
+
+		inline void reader_window::leave(unsigned ticket) {
+			counts[ticket].fetch_sub(1);
+		}
+
+		/** @brief Router that applications may replace while it dispatches
+		 * requests
+		 *
+		 * @remark A basic_router_handle dispatches each request to its current
+		 * basic_router. An application may publish() a new router at any
+		 * time—e.g., to reload its routing configuration—without stopping the
+		 * server. Requests already in progress finish with the router they
+		 * started with, and the handle destroys each replaced router once its last
+		 * such request finishes.
+		 *
+		 * @remark Dispatching takes no locks: it loads the current router with
+		 * an atomic load and holds it with an atomic reference count.
+		 *
+		 * @remark Copies of a handle share the same router, so an application
+		 * typically gives one copy to its server and keeps another for
+		 * publishing. Until the first call to publish(), the handle dispatches to
+		 * an empty router, which responds to every request with `404 Not found`.
+		 *
+		 * @sa basic_router */
+		template <typename Handler> class basic_router_handle {
+			struct table {
+				basic_router<Handler> router;
+				std::atomic<size_t> refs;
+				table(basic_router<Handler> &&r): router(std::move(r)), refs(1) {}
+			};
+			struct state {
+				std::atomic<table *> current;
+				reader_window window;
+				std::mutex writer; // serializes publishers
+				state(): current(new table(basic_router<Handler>())) {}
+				~state() { release(current.load()); }
+			};
+			std::shared_ptr<state> st;
+		public:
+			~basic_router_handle() {}
+			basic_router_handle(): st(std::make_shared<state>()) {}
+			basic_router_handle(basic_router_handle const &) = default;
+			basic_router_handle &operator=(basic_router_handle const &) = default;
+#ifndef CLANE_HAVE_NO_DEFAULT_MOVE
+			basic_router_handle(basic_router_handle &&) = default;
+			basic_router_handle &operator=(basic_router_handle &&) = default;
+#endif
+
+			void operator()(response_ostream &rs, request &req);
+
+			/** @brief Replaces the current router
+			 *
+			 * @remark The publish() method builds the new router's index before
+			 * publishing it, so that no request pays for building the index. The
+			 * publish() method may wait briefly for requests that are taking a
+			 * reference to the old router but doesn't wait for any request to
+			 * finish, so a request handler may safely publish a new router. */
+			void publish(basic_router<Handler> &&r);
+		private:
+			static void release(table *t);
+		};
+
+		template <typename Handler> void basic_router_handle<Handler>::operator()(response_ostream &rs, request &req) {
+			unsigned const ticket = st->window.enter();
+			table *const t = st->current.load();
+			t->refs.fetch_add(1, std::memory_order_relaxed);
+			st->window.leave(ticket);
+			std::unique_ptr<table, void (*)(table *)> hold(t, &release);
+			t->router(rs, req);
+		}
+
+		template <typename Handler> void basic_router_handle<Handler>::publish(basic_router<Handler> &&r) {
+			std::unique_ptr<table> t(new table(std::move(r)));
+			t->router.compile();
+			std::lock_guard<std::mutex> lock(st->writer);
+			table *const old = st->current.exchange(t.release());
+			st->window.synchronize();
+			release(old);
+		}
+
+		template <typename Handler> void basic_router_handle<Handler>::release(table *t) {
+			if (1 == t->refs.fetch_sub(1, std::memory_order_acq_rel))
+				delete t;
+		}
+
+		/** @brief Specializes basic_router_handle for a `std::function` request
+		 * handler */
+		typedef basic_router_handle<std::function<void(response_ostream &, request &)>> router_handle;
+
+		/** @brief Normalizes a Host header value
+		 *
+		 * @remark The normalized host is in lowercase and has no port and no
+		 * trailing dot. E.g., `"Example.COM.:8080"` becomes `"example.com"`, and
+		 * `"[::1]:8080"` becomes `"[::1]"`. */
+		std::string normalize_host(std::string const &host);
+
+		/** @brief HTTP request handler that dispatches requests to one request
+		 * handler per virtual host
+		 *
+		 * @remark A host router selects a virtual host according to the
+		 * request's Host header, which it normalizes with normalize_host(). Each
+		 * virtual host has a name, which is one of the following:
+		 *
+		 * @remark
+		 * - **Host name**, e.g., `"example.com"`, which matches only that host.
+		 * - **Wildcard**, e.g., `"*.example.com"`, which matches any subdomain of
+		 *   `example.com`—but not `example.com` itself. Where wildcards overlap,
+		 *   the longest wins.
+		 * - **Default**, i.e., `"*"`, which matches any host that no other name
+		 *   matches, as well as requests without a Host header.
+		 *
+		 * @remark Selecting a virtual host costs one hash table lookup for a host
+		 * name, plus one for each label of the host when falling back to
+		 * wildcards. No regular expressions are involved. If no virtual host
+		 * matches, the host router responds with `404 Not found`. A request with
+		 * more than one Host header gets `400 Bad request`.
+		 *
+		 * @remark Typically, each virtual host's request handler is a
+		 * basic_router, as with the host_router type.
+		 *
+		 * @sa basic_router */
+		template <typename Handler> class basic_host_router {
+			std::unordered_map<std::string, Handler> hosts;
+			std::unordered_map<std::string, Handler> wildcards; // by suffix, including the leading dot
+			std::unique_ptr<Handler> default_host;
+		public:
+			~basic_host_router() {}
+			basic_host_router() {}
+			basic_host_router(basic_host_router const &) = delete;
+			basic_host_router &operator=(basic_host_router const &) = delete;
+#ifndef CLANE_HAVE_NO_DEFAULT_MOVE
+			basic_host_router(basic_host_router &&) = default;
+			basic_host_router &operator=(basic_host_router &&) = default;
+#else
+			basic_host_router(basic_host_router &&that) noexcept { swap(that); }
+			basic_host_router &operator=(basic_host_router &&that) noexcept { swap(that); return *this; }
+#endif
+
+			void swap(basic_host_router &that) noexcept;
+			void operator()(response_ostream &rs, request &req);
+
+			/** @brief Adds a virtual host with a default-constructed request
+			 * handler, or returns the existing virtual host with the same name */
+			Handler &new_host(std::string const &name);
+
+			/** @brief Adds or replaces a virtual host */
+			Handler &new_host(std::string const &name, Handler &&h);
+
+			/** @brief Returns the request handler for a Host header value, or
+			 * `nullptr` if no virtual host matches */
+			Handler *find(std::string const &host);
+		};
+
+		template <typename Handler> void basic_host_router<Handler>::swap(basic_host_router &that) noexcept {
+			std::swap(hosts, that.hosts);
+			std::swap(wildcards, that.wildcards);
+			std::swap(default_host, that.default_host);
+		}
+
+		template <typename Handler> void basic_host_router<Handler>::operator()(response_ostream &rs, request &req) {
+			auto r = req.headers.equal_range(header_id::host);
+			Handler *h;
+			if (r.first == r.second) {
+				h = default_host.get();
+			} else if (std::next(r.first) != r.second) {
+				rs.status = status_code::bad_request;
+				return;
+			} else {
+				h = find(r.first->second);
+			}
+			if (!h) {
+				rs.status = status_code::not_found;
+				return;
+			}
+			(*h)(rs, req);
+		}
+
+		template <typename Handler> Handler &basic_host_router<Handler>::new_host(std::string const &name) {
+			if ("*" == name) {
+				if (!default_host)
+					default_host.reset(new Handler);
+				return *default_host;
+			}
+			std::string const key = normalize_host(name);
+			if (!key.compare(0, 2, "*."))
+				return wildcards[key.substr(1)];
+			return hosts[key];
+		}
+
+		template <typename Handler> Handler &basic_host_router<Handler>::new_host(std::string const &name, Handler &&h) {
+			return new_host(name) = std::move(h);
+		}
+
+		template <typename Handler> Handler *basic_host_router<Handler>::find(std::string const &host) {
+			std::string const key = normalize_host(host);
+			auto p = hosts.find(key);
+			if (p != hosts.end())
+				return &p->second;
+			if (!wildcards.empty()) {
+				// Try each suffix beginning with a dot, from longest to shortest.
+				for (size_t pos = key.find('.'); pos != std::string::npos; pos = key.find('.', pos + 1)) {
+					auto w = wildcards.find(key.substr(pos));
+					if (w != wildcards.end())
+						return &w->second;
+				}
+			}
+			return default_host.get();
+		}
+
+		/** @brief Specializes basic_host_router for a basic_router per virtual
+		 * host */
+		typedef basic_host_router<router> host_router;
 	}
 }
 
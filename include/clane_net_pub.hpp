@@ -15,6 +15,9 @@
 #include "clane_posix_pub.hpp"
 #include <chrono>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <system_error>
 #include <vector>
 
@@ -33,17 +36,24 @@ namespace clane {
 			all = 1<<0
 		};
 
+		// listen() flags:
+		enum {
+			reuse_port = 1<<0 // allow multiple listeners to bind to the same address
+		};
+
 		struct protocol_family {
 			void (*construct_descriptor)(socket_descriptor &sd);
 			void (*destruct_descriptor)(socket_descriptor &sd);
 			int (*descriptor)(socket_descriptor const &sd);
-			socket (*new_listener)(std::string &addr, int backlog);
+			socket (*new_listener)(std::string &addr, int backlog, int flags);
 			socket (*new_connection)(std::string &addr, std::error_code &e);
 			void (*set_nonblocking)(socket_descriptor &sd);
 			std::string (*local_address)(socket_descriptor &sd);
 			std::string (*remote_address)(socket_descriptor &sd);
 			socket (*accept)(socket_descriptor &sd, std::string *oaddr, std::error_code &e);
 			size_t (*send)(socket_descriptor &sd, void const *p, size_t n, int flags, std::error_code &e);
+			size_t (*sendv)(socket_descriptor &sd, iovec const *iov, size_t cnt, int flags, std::error_code &e);
+			size_t (*sendfile)(socket_descriptor &sd, int in_fd, off_t &offset, size_t n, int flags, std::error_code &e);
 			size_t (*recv)(socket_descriptor &sd, void *p, size_t n, int flags, std::error_code &e);
 			void (*fin)(socket_descriptor &sd);
 		};
@@ -53,10 +63,10 @@ namespace clane {
 			socket_descriptor sd;
 		public:
 			~socket() { if (pf) { pf->destruct_descriptor(sd); }}
-			socket() noexcept: pf{} {}
+			socket() noexcept: pf{}, sd{} {}
 			socket(protocol_family const *pf, clane::posix::unique_fd &&fd): pf{pf} { sd.n = fd.release(); }
 			socket(socket const &) = delete;
-			socket(socket &&that) noexcept: pf{} { swap(that); }
+			socket(socket &&that) noexcept: pf{}, sd{} { swap(that); }
 			socket &operator=(socket const &) = delete;
 			socket &operator=(socket &&that) noexcept;
 			void swap(socket &that) noexcept;
@@ -68,6 +78,12 @@ namespace clane {
 			socket accept(std::string &addr_o, std::error_code &e);
 			size_t send(void const *p, size_t n, std::error_code &e) { return pf->send(sd, p, n, 0, e); }
 			size_t send(void const *p, size_t n, int flags, std::error_code &e) { return pf->send(sd, p, n, flags, e); }
+			size_t sendv(iovec const *iov, size_t cnt, std::error_code &e) { return pf->sendv(sd, iov, cnt, 0, e); }
+			size_t sendv(iovec const *iov, size_t cnt, int flags, std::error_code &e) { return pf->sendv(sd, iov, cnt, flags, e); }
+			size_t sendfile(int in_fd, off_t &offset, size_t n, std::error_code &e) { return pf->sendfile(sd, in_fd, offset, n, 0, e); }
+			size_t sendfile(int in_fd, off_t &offset, size_t n, int flags, std::error_code &e) {
+				return pf->sendfile(sd, in_fd, offset, n, flags, e);
+			}
 			size_t recv(void *p, size_t n, std::error_code &e) { return pf->recv(sd, p, n, 0, e); }
 			size_t recv(void *p, size_t n, int flags, std::error_code &e) { return pf->recv(sd, p, n, flags, e); }
 			void fin() { pf->fin(sd); }
@@ -91,12 +107,12 @@ namespace clane {
 		 	return pf->accept(sd, &addr_o, e);
 	 	}
 
-		inline socket listen(protocol_family const *pf, std::string addr, int backlog = -1) {
-			return pf->new_listener(addr, backlog);
+		inline socket listen(protocol_family const *pf, std::string addr, int backlog = -1, int flags = 0) {
+			return pf->new_listener(addr, backlog, flags);
 		}
 
-		inline socket listen(protocol_family const *pf, char const *addr, int backlog = -1) {
-			return listen(pf, std::string(addr), backlog);
+		inline socket listen(protocol_family const *pf, char const *addr, int backlog = -1, int flags = 0) {
+			return listen(pf, std::string(addr), backlog, flags);
 		}
 
 		inline socket connect(protocol_family const *pf, std::string addr, std::error_code &e) {
@@ -163,6 +179,74 @@ namespace clane {
 			return items.size(); // 1-based index
 		}
 
+		/** @brief Readiness notification returned by a reactor */
+		class reactor_event {
+		public:
+			void *data;
+			int events;
+		};
+
+		/** @brief Edge-triggered I/O multiplexer
+		 *
+		 * @remark Unlike a poller, which rescans all of its items after every
+		 * wakeup, a reactor is backed by epoll and reports only the descriptors
+		 * that have become ready, so one reactor may hold thousands of
+		 * descriptors at a cost proportional to the number of ready descriptors.
+		 *
+		 * @remark All registrations are edge-triggered. A reactor reports a
+		 * descriptor again only after its readiness state changes, so the owner
+		 * must read (or write) until the operation would block before waiting on
+		 * the reactor again. Each registration carries an opaque data pointer,
+		 * which the reactor returns with each readiness notification for that
+		 * descriptor. */
+		class reactor {
+		public:
+			enum {
+				in = EPOLLIN,
+				out = EPOLLOUT,
+				error = EPOLLERR,
+				hangup = EPOLLHUP,
+#ifdef EPOLLEXCLUSIVE
+				exclusive = EPOLLEXCLUSIVE // wake only one of many reactors sharing a descriptor
+#else
+				exclusive = 0
+#endif
+			};
+		private:
+			posix::unique_fd fd;
+			std::vector<epoll_event> ready;
+		public:
+			~reactor() = default;
+			reactor();
+			reactor(reactor const &) = delete;
+			reactor(reactor &&that) noexcept: fd(std::move(that.fd)), ready(std::move(that.ready)) {}
+			reactor &operator=(reactor const &) = delete;
+			reactor &operator=(reactor &&that) noexcept { fd = std::move(that.fd); ready = std::move(that.ready); return *this; }
+			template <class Pollable> void add(Pollable const &x, int ev_flags, void *data);
+			template <class Pollable> void modify(Pollable const &x, int ev_flags, void *data);
+			template <class Pollable> void remove(Pollable const &x);
+			size_t wait(reactor_event *evs, size_t n);
+			size_t wait(reactor_event *evs, size_t n, std::chrono::steady_clock::time_point const &to);
+			size_t wait(reactor_event *evs, size_t n, std::chrono::steady_clock::duration const &to);
+		private:
+			void add_fd(int pfd, int ev_flags, void *data);
+			void modify_fd(int pfd, int ev_flags, void *data);
+			void remove_fd(int pfd);
+			size_t wait(reactor_event *evs, size_t n, int to);
+		};
+
+		template <class Pollable> void reactor::add(Pollable const &x, int ev_flags, void *data) {
+			add_fd(x.descriptor(), ev_flags, data);
+		}
+
+		template <class Pollable> void reactor::modify(Pollable const &x, int ev_flags, void *data) {
+			modify_fd(x.descriptor(), ev_flags, data);
+		}
+
+		template <class Pollable> void reactor::remove(Pollable const &x) {
+			remove_fd(x.descriptor());
+		}
+
 	}
 
 }
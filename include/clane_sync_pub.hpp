@@ -12,8 +12,13 @@
  * @brief Concurrency synchronization */
 
 #include "clane_base_pub.hpp"
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <functional>
 #include <mutex>
+#include <pthread.h>
+#include <vector>
 
 namespace clane {
 
@@ -85,6 +90,107 @@ namespace clane {
 			void increment();
 		};
 
+		/** @brief Fixed-size set of worker threads that run queued tasks
+		 *
+		 * @remark A thread_pool creates all of its worker threads upfront, so
+		 * running a task never incurs the cost of creating a thread. Tasks run in
+		 * the order they're submitted. The task queue may be bounded, in which
+		 * case submitting a task to a full queue fails rather than blocks.
+		 *
+		 * @remark Destroying a thread_pool blocks until all queued tasks have run
+		 * and all worker threads have exited. */
+		class thread_pool {
+		public:
+
+			/** @brief Task type */
+			typedef std::function<void()> task;
+
+			/** @brief Snapshot of a thread_pool's queueing metrics */
+			class statistics {
+			public:
+
+				/** @brief Number of tasks that have started running */
+				unsigned long long started;
+
+				/** @brief Number of tasks rejected because the queue was full */
+				unsigned long long rejected;
+
+				/** @brief Number of tasks currently waiting in the queue */
+				size_t queued;
+
+				/** @brief Cumulative time started tasks spent waiting in the queue */
+				std::chrono::steady_clock::duration total_wait;
+
+				/** @brief Longest time any started task spent waiting in the queue */
+				std::chrono::steady_clock::duration max_wait;
+			};
+
+		private:
+			struct item {
+				task t;
+				std::chrono::steady_clock::time_point queued;
+			};
+			std::mutex mutex;
+			std::condition_variable cond;
+			std::deque<item> queue;
+			size_t max_queue;
+			bool stopping;
+			statistics stats_;
+			std::vector<pthread_t> workers;
+
+		public:
+
+			/** @brief Runs all queued tasks and then stops all worker threads */
+			~thread_pool();
+
+			/** @brief Starts a given number of worker threads
+			 *
+			 * @param size Number of worker threads, at least one.
+			 *
+			 * @param queue_depth Maximum number of tasks waiting to run, or `0` for
+			 * no limit.
+			 *
+			 * @param stack_size Stack size, in bytes, of each worker thread, or `0`
+			 * for the platform default. */
+			thread_pool(size_t size, size_t queue_depth = 0, size_t stack_size = 0);
+
+			/** @brief Deleted */
+			thread_pool(thread_pool const &) = delete;
+
+			/** @brief Deleted */
+			thread_pool(thread_pool &&) = delete;
+
+			/** @brief Deleted */
+			thread_pool &operator=(thread_pool const &) = delete;
+
+			/** @brief Deleted */
+			thread_pool &operator=(thread_pool &&) = delete;
+
+			/** @brief Queues a task to run on a worker thread
+			 *
+			 * @return The submit() method returns true if the task was queued, or
+			 * false if the queue is full. */
+			bool submit(task &&t);
+
+			/** @brief Returns the number of worker threads */
+			size_t size() const { return workers.size(); }
+
+			/** @brief Returns a snapshot of the queueing metrics */
+			statistics stats();
+
+		private:
+			static void *worker_main(void *arg);
+			void run();
+			void stop();
+		};
+
+		/** @brief Pins the calling thread to one CPU
+		 *
+		 * @remark The pin_thread() function restricts the calling thread to run
+		 * only on the `n`th CPU, modulo the number of CPUs, among the CPUs that the
+		 * process may run on. */
+		void pin_thread(size_t n);
+
 	}
 
 }
@@ -0,0 +1,185 @@
+// vim: set noet:
+
+// Measures the HTTP/1.x request parser and its scanning kernels on a
+// browser-like request head. Run by hand; the result isn't checked.
+
+#include "../clane_ascii.hpp"
+#include "../clane_http_parse.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+using namespace clane;
+
+static char const *const head =
+	"GET /search/results?q=incremental+http+parser&lang=en&page=2 HTTP/1.1\r\n"
+	"Host: www.example.com\r\n"
+	"Connection: keep-alive\r\n"
+	"Cache-Control: max-age=0\r\n"
+	"sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", \"Not=A?Brand\";v=\"99\"\r\n"
+	"sec-ch-ua-mobile: ?0\r\n"
+	"sec-ch-ua-platform: \"Linux\"\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+		"Chrome/118.0.0.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,"
+		"image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+	"Sec-Fetch-Site: same-origin\r\n"
+	"Sec-Fetch-Mode: navigate\r\n"
+	"Sec-Fetch-User: ?1\r\n"
+	"Sec-Fetch-Dest: document\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Accept-Language: en-US,en;q=0.9\r\n"
+	"Cookie: session=4f8a2c1e9b7d6a5f3e2d1c0b; theme=dark; _ga=GA1.2.1234567890.1697040000\r\n"
+	"\r\n";
+
+static size_t const iterations = 200000;
+
+// stream-based integer parsing, as the parsers once did, for comparison
+static bool stream_parse_version(int *major_ver, int *minor_ver, std::string const &s) {
+	std::istringstream pss(s.substr(5));
+	pss.unsetf(pss.skipws);
+	pss >> *major_ver;
+	if (!pss || pss.get() != '.')
+		return false;
+	pss >> *minor_ver;
+	return pss && pss.get() == std::istringstream::traits_type::eof();
+}
+
+static bool stream_parse_size(size_t &n, std::string const &s) {
+	std::istringstream ss(s);
+	ss >> n;
+	return ss && ss.eof();
+}
+
+template <typename Func> static void measure(char const *what, Func f) {
+	auto const start = std::chrono::steady_clock::now();
+	size_t sink = 0;
+	for (size_t i = 0; i < iterations; ++i)
+		sink += f();
+	auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	std::printf("%-40s %8.1f ns/op  (%zu)\n", what, static_cast<double>(ns) / iterations, sink % 10);
+}
+
+int main() {
+
+	std::string const s(head);
+	char const *const beg = s.data();
+	char const *const end = s.data() + s.size();
+	std::printf("request head: %zu bytes\n", s.size());
+
+	// a header block without line ends, as if it were one long value
+	std::string flat(s);
+	std::replace(flat.begin(), flat.end(), '\r', ' ');
+	std::replace(flat.begin(), flat.end(), '\n', ' ');
+	char const *const flat_beg = flat.data();
+	char const *const flat_end = flat.data() + flat.size();
+
+	measure("newline scan, std::find", [beg, end]() -> size_t {
+		size_t n = 0;
+		for (char const *p = beg; (p = std::find(p, end, '\n')) != end; ++p)
+			++n;
+		return n;
+	});
+	measure("newline scan, ascii::find_char", [beg, end]() -> size_t {
+		size_t n = 0;
+		for (char const *p = beg; (p = ascii::find_char(p, end, '\n')) != end; ++p)
+			++n;
+		return n;
+	});
+
+	static char const *const names[] = { "none", "sse2", "avx2" };
+	ascii::simd_level const orig = ascii::simd();
+	for (int i = 0; i < 3; ++i) {
+		ascii::simd_level const level = static_cast<ascii::simd_level>(i);
+		if (!ascii::set_simd(level))
+			continue;
+		std::string what = std::string("control scan, ") + names[i];
+		measure(what.c_str(), [flat_beg, flat_end]() -> size_t {
+			return ascii::find_control_char(flat_beg, flat_end) - flat_beg;
+		});
+		what = std::string("request parse, ") + names[i];
+		http::v1x_request_incparser pars;
+		measure(what.c_str(), [beg, end, &pars]() -> size_t {
+			pars.reset();
+			size_t const n = pars.parse_some(beg, end);
+			if (n != static_cast<size_t>(end - beg) || pars) {
+				std::fprintf(stderr, "parse failed\n");
+				std::exit(1);
+			}
+			return pars.headers().size();
+		});
+	}
+	ascii::set_simd(orig);
+
+	// integers in a request head, e.g., "HTTP/1.1" and "Content-Length: 1234":
+	std::string const ver("HTTP/1.1");
+	std::string const len("1234");
+	measure("version and length, istringstream", [&ver, &len]() -> size_t {
+		int major, minor;
+		size_t n;
+		return stream_parse_version(&major, &minor, ver) && stream_parse_size(n, len) ? n + minor : 0;
+	});
+	measure("version and length, parse_decimal", [&ver, &len]() -> size_t {
+		int major, minor;
+		size_t n;
+		return http::parse_version(&major, &minor, ver) &&
+			ascii::parse_decimal(len.data(), len.data() + len.size(), n) ? n + minor : 0;
+	});
+
+	// header lookups in a parsed request, as the server and handlers do them:
+	{
+		http::v1x_request_incparser pars;
+		pars.reset();
+		pars.parse_some(beg, end);
+		http::header_map const &hdrs = pars.headers();
+		static char const *const keys[] = { "host", "content-length", "transfer-encoding", "accept-encoding" };
+		measure("header lookups, name compares", [&hdrs]() -> size_t {
+			size_t n = 0;
+			for (size_t i = 0; i < 4; ++i) {
+				for (auto j = hdrs.begin(); j != hdrs.end(); ++j) {
+					if (!ascii::icase_compare(j->first, keys[i])) {
+						++n;
+						break;
+					}
+				}
+			}
+			return n;
+		});
+		measure("header lookups, by name", [&hdrs]() -> size_t {
+			size_t n = 0;
+			for (size_t i = 0; i < 4; ++i)
+				n += hdrs.end() != hdrs.find(keys[i]);
+			return n;
+		});
+		static http::header_id const ids[] = {
+			http::header_id::host,
+			http::header_id::content_length,
+			http::header_id::transfer_encoding,
+			http::header_id::accept_encoding
+		};
+		measure("header lookups, by ID", [&hdrs]() -> size_t {
+			size_t n = 0;
+			for (size_t i = 0; i < 4; ++i)
+				n += hdrs.end() != hdrs.find(ids[i]);
+			return n;
+		});
+	}
+
+	// A head split across two blocks can't be parsed in one pass.
+	http::v1x_request_incparser pars;
+	measure("request parse, split head", [beg, end, &pars]() -> size_t {
+		pars.reset();
+		size_t n = pars.parse_some(beg, beg + 10);
+		n += pars.parse_some(beg + n, end);
+		if (n != static_cast<size_t>(end - beg) || pars) {
+			std::fprintf(stderr, "parse failed\n");
+			std::exit(1);
+		}
+		return pars.headers().size();
+	});
+}
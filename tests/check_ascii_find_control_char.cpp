@@ -0,0 +1,46 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_ascii.hpp"
+#include <string>
+
+using namespace clane;
+
+static void check_all(size_t size) {
+
+	// no control characters, including bytes outside the ASCII range:
+	std::string s;
+	for (size_t i = 0; i < size; ++i)
+		s.push_back(static_cast<char>(i % 3 ? 'a' + i % 26 : (i % 2 ? '\t' : '\x80' + i % 128)));
+	check(s.data()+s.size() == ascii::find_control_char(s.data(), s.data()+s.size()));
+
+	// one control character at each position, finding only the first:
+	static char const ctls[] = { '\0', '\x01', '\n', '\r', '\x1f', '\x7f' };
+	for (size_t i = 0; i < size; ++i) {
+		for (size_t j = 0; j < sizeof(ctls); ++j) {
+			std::string t = s;
+			t[i] = ctls[j];
+			if (i + 1 < size)
+				t[size-1] = '\0';
+			check(t.data()+i == ascii::find_control_char(t.data(), t.data()+t.size()));
+		}
+	}
+}
+
+int main() {
+	ascii::simd_level const levels[] = {
+		ascii::simd_level::none,
+		ascii::simd_level::sse2,
+		ascii::simd_level::avx2
+	};
+	ascii::simd_level const orig = ascii::simd();
+	for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i) {
+		if (!ascii::set_simd(levels[i]))
+			continue;
+		check(ascii::simd() == levels[i]);
+		for (size_t size = 0; size < 100; ++size)
+			check_all(size);
+	}
+	check(ascii::set_simd(orig));
+	check(ascii::set_simd(ascii::simd_level::none));
+}
@@ -0,0 +1,35 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_message.hpp"
+
+using namespace clane;
+
+int main() {
+
+	// listed codings:
+	check(1.0f == http::accept_encoding_quality("gzip", "gzip"));
+	check(1.0f == http::accept_encoding_quality("gzip, deflate, br", "br"));
+	check(1.0f == http::accept_encoding_quality("GZIP", "gzip"));
+	check(0.5f == http::accept_encoding_quality("br;q=0.5, gzip", "br"));
+	check(0.25f == http::accept_encoding_quality("br ; q=0.25", "br"));
+	check(0.0f == http::accept_encoding_quality("gzip;q=0", "gzip"));
+
+	// unlisted codings:
+	check(0.0f == http::accept_encoding_quality("gzip", "br"));
+	check(0.0f == http::accept_encoding_quality("", "gzip"));
+	check(0.75f == http::accept_encoding_quality("gzip, *;q=0.75", "br"));
+	check(1.0f == http::accept_encoding_quality("*", "br"));
+
+	// identity is acceptable unless excluded:
+	check(1.0f == http::accept_encoding_quality("gzip", "identity"));
+	check(1.0f == http::accept_encoding_quality("", "identity"));
+	check(0.0f == http::accept_encoding_quality("identity;q=0", "identity"));
+	check(0.0f == http::accept_encoding_quality("gzip, *;q=0", "identity"));
+
+	// malformed quality values:
+	check(0.0f == http::accept_encoding_quality("gzip;q=", "gzip"));
+	check(0.0f == http::accept_encoding_quality("gzip;q=2", "gzip"));
+	check(0.0f == http::accept_encoding_quality("gzip;q=-1", "gzip"));
+}
+
@@ -0,0 +1,36 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_message.hpp"
+
+using namespace clane;
+
+int main() {
+
+	time_t const t = 784111777; // Sun, 06 Nov 1994 08:49:37 GMT
+
+	// format:
+	check(http::format_http_date(t) == "Sun, 06 Nov 1994 08:49:37 GMT");
+	check(http::format_http_date(0) == "Thu, 01 Jan 1970 00:00:00 GMT");
+
+	// parse, in each format:
+	time_t u;
+	check(http::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", u));
+	check(t == u);
+	check(http::parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", u));
+	check(t == u);
+	check(http::parse_http_date("Sun Nov  6 08:49:37 1994", u));
+	check(t == u);
+	check(http::parse_http_date(http::format_http_date(1400000000), u));
+	check(1400000000 == u);
+
+	// invalid:
+	check(!http::parse_http_date("", u));
+	check(!http::parse_http_date("garbage", u));
+	check(!http::parse_http_date("Sun, 06 Nov 1994 08:49:37", u));
+	check(!http::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT trailing", u));
+	check(!http::parse_http_date("Sun, 06 Foo 1994 08:49:37 GMT", u));
+	check(!http::parse_http_date("Sun, 32 Nov 1994 08:49:37 GMT", u));
+	check(!http::parse_http_date("Sun, 06 Nov 1994 24:49:37 GMT", u));
+}
+
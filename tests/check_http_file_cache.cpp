@@ -0,0 +1,117 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_file.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <thread>
+
+using namespace clane;
+
+int main() {
+
+	char tmpl[] = "/tmp/check_http_file_cache.XXXXXX";
+	check(::mkdtemp(tmpl));
+	boost::filesystem::path root(tmpl);
+	std::string const a = (root / "a.txt").string();
+	std::string const b = (root / "b.txt").string();
+	std::string const c = (root / "c.txt").string();
+	boost::filesystem::ofstream(a) << "alpha";
+	boost::filesystem::ofstream(b) << "bravo";
+	boost::filesystem::ofstream(c) << "charlie";
+
+	// A cached entry holds the open file and its metadata until it expires,
+	// even if the file changes.
+	{
+		http::file_cache cache(8, std::chrono::milliseconds(200));
+		auto ent = cache.lookup(a);
+		check(!ent->error);
+		check(S_ISREG(ent->mode));
+		check(5 == ent->size);
+		check(ent->fd);
+		check(ent == cache.lookup(a));
+		boost::filesystem::ofstream(a) << "alpha, again";
+		check(ent == cache.lookup(a));
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		auto ent2 = cache.lookup(a);
+		check(ent2 != ent);
+		check(12 == ent2->size);
+	}
+
+	// Directories and missing files are cached without descriptors.
+	{
+		http::file_cache cache(8, std::chrono::seconds(60));
+		auto ent = cache.lookup(root.string());
+		check(!ent->error);
+		check(S_ISDIR(ent->mode));
+		check(!ent->fd);
+		ent = cache.lookup((root / "missing").string());
+		check(ENOENT == ent->error);
+		check(!ent->fd);
+	}
+
+	// The cache holds at most its capacity, evicting the oldest entries first.
+	{
+		http::file_cache cache(2, std::chrono::seconds(60));
+		auto ea = cache.lookup(a);
+		auto eb = cache.lookup(b);
+		check(2 == cache.size());
+		auto ec = cache.lookup(c);
+		check(2 == cache.size());
+		check(eb == cache.lookup(b));
+		check(ec == cache.lookup(c));
+		check(ea != cache.lookup(a));
+	}
+
+	// Lookups evict expired entries, closing their descriptors, even when the
+	// looked-up path is cached.
+	{
+		http::file_cache cache(8, std::chrono::milliseconds(200));
+		auto ea = cache.lookup(a);
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		auto eb = cache.lookup(b);
+		check(1 == cache.size());
+		std::weak_ptr<posix::unique_fd> fa = ea->fd;
+		ea.reset();
+		check(fa.expired());
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		cache.lookup(b);
+		check(1 == cache.size());
+		check(eb != cache.lookup(b));
+	}
+
+	// The default capacity is a small fraction of the descriptor limit.
+	{
+		struct ::rlimit rl;
+		check(0 == ::getrlimit(RLIMIT_NOFILE, &rl));
+		check(http::file_server::default_cache_capacity() <= http::file_server::max_default_cache_capacity);
+		if (RLIM_INFINITY != rl.rlim_cur)
+			check(http::file_server::default_cache_capacity() <= rl.rlim_cur / 16);
+	}
+
+	// A metadata lookup returns the cached entry, if any, or else stats the
+	// file without opening or caching it.
+	{
+		http::file_cache cache(8, std::chrono::seconds(60));
+		auto ent = cache.lookup_metadata(b);
+		check(!ent->error);
+		check(S_ISREG(ent->mode));
+		check(5 == ent->size);
+		check(!ent->fd);
+		check(0 == cache.size());
+		check(ENOENT == cache.lookup_metadata((root / "missing").string())->error);
+		auto cached = cache.lookup(b);
+		check(cached == cache.lookup_metadata(b));
+	}
+
+	// A zero capacity disables caching.
+	{
+		http::file_cache cache(0, std::chrono::seconds(60));
+		check(cache.lookup(b) != cache.lookup(b));
+		check(0 == cache.size());
+	}
+
+	boost::filesystem::remove_all(root);
+}
+
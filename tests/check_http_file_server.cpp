@@ -2,12 +2,272 @@
 
 #include "clane_check.hpp"
 #include "../clane_http_file.hpp"
+#include "../clane_net_inet.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <cstdlib>
+#include <cstring>
 
 using namespace clane;
 
+// Sends a GET request and receives the response, which must have a content
+// length.
+static std::string get(std::string const &saddr, std::string const &path, std::string &body,
+	std::string const &extra_hdrs = std::string()) {
+	std::error_code e;
+	auto cli = net::connect(&net::tcp4, saddr, e);
+	check(!e);
+	std::string req = "GET " + path + " HTTP/1.1\r\n" + extra_hdrs + "\r\n";
+	cli.send(req.data(), req.size(), net::all, e);
+	check(!e);
+	cli.fin();
+	std::string resp;
+	while (true) {
+		char buf[65536];
+		size_t xstat = cli.recv(buf, sizeof(buf), e);
+		check(!e);
+		if (!xstat)
+			break;
+		resp += std::string(buf, xstat);
+	}
+	size_t hdrs_end = resp.find("\r\n\r\n");
+	check(std::string::npos != hdrs_end);
+	body = resp.substr(hdrs_end + 4);
+	return resp.substr(0, hdrs_end + 2);
+}
+
 int main() {
-	http::file_server fs(".");
-	// TODO: add more test cases
-	return 77;
+
+	// set up a directory to serve:
+	char tmpl[] = "/tmp/check_http_file_server.XXXXXX";
+	check(::mkdtemp(tmpl));
+	boost::filesystem::path root(tmpl);
+	std::string small_content = "Hello, from Clane!\n";
+	std::string big_content;
+	for (int i = 0; big_content.size() < 3 * 1024 * 1024; ++i)
+		big_content += std::to_string(i) + '\n';
+	boost::filesystem::ofstream(root / "small.txt") << small_content;
+	boost::filesystem::ofstream(root / "big.txt") << big_content;
+	boost::filesystem::ofstream(root / "app.js") << "identity";
+	boost::filesystem::ofstream(root / "app.js.gz") << "gzip";
+	boost::filesystem::ofstream(root / "app.js.br") << "br";
+	boost::filesystem::ofstream(root / "only_gz.js") << "identity";
+	boost::filesystem::ofstream(root / "only_gz.js.gz") << "gzip";
+
+	// Small files are served from memory.
+	http::file_server fs(root, 16, std::chrono::seconds(1), 64 * 1024);
+
+	// A recorded response receives a copy of the file.
+	{
+		std::istringstream req_body;
+		http::request req(req_body.rdbuf());
+		req.method = "GET";
+		req.uri = uri::parse_uri_reference("/small.txt");
+		http::response_record rr;
+		fs(rr.record(), req);
+		check(http::status_code::ok == rr.status);
+		check(rr.headers.find("content-length")->second == std::to_string(small_content.size()));
+		check(rr.body.str() == small_content);
+	}
+
+	// Without a cache, a conditional request is answered from the file's
+	// metadata, and a file that has changed is still served whole.
+	{
+		http::file_server uncached(root, 0, std::chrono::seconds(1));
+		std::istringstream req_body;
+		http::request req(req_body.rdbuf());
+		req.method = "HEAD";
+		req.uri = uri::parse_uri_reference("/small.txt");
+		http::response_record rr;
+		uncached(rr.record(), req);
+		std::string const etag = rr.headers.find("etag")->second;
+
+		http::request req2(req_body.rdbuf());
+		req2.method = "GET";
+		req2.uri = uri::parse_uri_reference("/small.txt");
+		req2.headers.insert(http::header("if-none-match", etag));
+		http::response_record rr2;
+		uncached(rr2.record(), req2);
+		check(http::status_code::not_modified == rr2.status);
+		check(rr2.headers.find("etag")->second == etag);
+		check(rr2.body.str().empty());
+
+		http::request req3(req_body.rdbuf());
+		req3.method = "GET";
+		req3.uri = uri::parse_uri_reference("/small.txt");
+		req3.headers.insert(http::header("if-none-match", "\"x\""));
+		http::response_record rr3;
+		uncached(rr3.record(), req3);
+		check(http::status_code::ok == rr3.status);
+		check(rr3.body.str() == small_content);
+	}
+
+	// run server:
+	http::server s;
+	s.root_handler = fs;
+	auto lis = net::listen(&net::tcp, "localhost:");
+	std::string saddr = lis.local_address();
+	s.add_listener(std::move(lis));
+	std::thread thrd(&http::server::serve, &s);
+
+	// A response sent by the server transmits the file directly.
+	{
+		std::string body;
+		std::string hdrs = get(saddr, "/big.txt", body);
+		check(0 == hdrs.find("HTTP/1.1 200 OK\r\n"));
+		check(std::string::npos != hdrs.find("\r\nContent-Length: " + std::to_string(big_content.size()) + "\r\n"));
+		check(body == big_content);
+	}
+
+	// A small file is served from memory.
+	for (int i = 0; i < 2; ++i) {
+		std::string body;
+		std::string hdrs = get(saddr, "/small.txt", body);
+		check(0 == hdrs.find("HTTP/1.1 200 OK\r\n"));
+		check(std::string::npos != hdrs.find("\r\nContent-Length: " + std::to_string(small_content.size()) + "\r\n"));
+		check(body == small_content);
+	}
+
+	// single byte range:
+	{
+		std::string body;
+		std::string hdrs = get(saddr, "/big.txt", body, "Range: bytes=1000-1999\r\n");
+		check(0 == hdrs.find("HTTP/1.1 206 "));
+		check(std::string::npos != hdrs.find("\r\nContent-Range: bytes 1000-1999/" + std::to_string(big_content.size()) + "\r\n"));
+		check(std::string::npos != hdrs.find("\r\nContent-Length: 1000\r\n"));
+		check(body == big_content.substr(1000, 1000));
+	}
+
+	// multiple byte ranges:
+	{
+		std::string body;
+		std::string hdrs = get(saddr, "/small.txt", body, "Range: bytes=0-4, -6\r\n");
+		check(0 == hdrs.find("HTTP/1.1 206 "));
+		size_t bpos = hdrs.find("\r\nContent-Type: multipart/byteranges; boundary=");
+		check(std::string::npos != bpos);
+		bpos += std::strlen("\r\nContent-Type: multipart/byteranges; boundary=");
+		std::string boundary = hdrs.substr(bpos, hdrs.find("\r\n", bpos) - bpos);
+		std::string const size = std::to_string(small_content.size());
+		std::string exp_body =
+			"--" + boundary + "\r\n"
+			"Content-Range: bytes 0-4/" + size + "\r\n"
+			"\r\n" +
+			small_content.substr(0, 5) +
+			"\r\n--" + boundary + "\r\n"
+			"Content-Range: bytes " + std::to_string(small_content.size() - 6) + '-' +
+				std::to_string(small_content.size() - 1) + '/' + size + "\r\n"
+			"\r\n" +
+			small_content.substr(small_content.size() - 6) +
+			"\r\n--" + boundary + "--\r\n";
+		// Each part has a Content-Type header only if the MIME map knows .txt.
+		std::string parts = body;
+		for (size_t p; std::string::npos != (p = parts.find("Content-Type: ")); )
+			parts.erase(p, parts.find("\r\n", p) + 2 - p);
+		check(parts == exp_body);
+		check(std::string::npos != hdrs.find("\r\nContent-Length: " + std::to_string(body.size()) + "\r\n"));
+	}
+
+	// unsatisfiable byte range:
+	{
+		std::string body;
+		std::string hdrs = get(saddr, "/small.txt", body, "Range: bytes=5000-\r\n");
+		check(0 == hdrs.find("HTTP/1.1 416 "));
+		check(std::string::npos != hdrs.find("\r\nContent-Range: bytes */" + std::to_string(small_content.size()) + "\r\n"));
+		check(body.empty());
+	}
+
+	// conditional requests, for files served from memory and from disk:
+	for (auto path: {"/small.txt", "/big.txt"}) {
+		std::string body;
+		std::string hdrs = get(saddr, path, body);
+		auto header_value = [&](std::string const &name) {
+			size_t pos = hdrs.find("\r\n" + name + ": ");
+			check(std::string::npos != pos);
+			pos += name.size() + 4;
+			return hdrs.substr(pos, hdrs.find("\r\n", pos) - pos);
+		};
+		std::string const etag = header_value("Etag");
+		std::string const last_modified = header_value("Last-Modified");
+
+		hdrs = get(saddr, path, body, "If-None-Match: \"x\", " + etag + "\r\n");
+		check(0 == hdrs.find("HTTP/1.1 304 "));
+		check(std::string::npos != hdrs.find("\r\nEtag: "));
+		check(std::string::npos == hdrs.find("\r\nContent-Length: "));
+		check(body.empty());
+
+		hdrs = get(saddr, path, body, "If-None-Match: *\r\n");
+		check(0 == hdrs.find("HTTP/1.1 304 "));
+
+		hdrs = get(saddr, path, body, "If-Modified-Since: " + last_modified + "\r\n");
+		check(0 == hdrs.find("HTTP/1.1 304 "));
+		check(body.empty());
+
+		// If-None-Match takes precedence over If-Modified-Since.
+		hdrs = get(saddr, path, body, "If-None-Match: \"x\"\r\nIf-Modified-Since: " + last_modified + "\r\n");
+		check(0 == hdrs.find("HTTP/1.1 200 "));
+
+		hdrs = get(saddr, path, body, "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n");
+		check(0 == hdrs.find("HTTP/1.1 200 "));
+		check(!body.empty());
+
+		hdrs = get(saddr, path, body, "If-Modified-Since: garbage\r\n");
+		check(0 == hdrs.find("HTTP/1.1 200 "));
+
+		// A Range request whose If-Range fails gets the whole file.
+		hdrs = get(saddr, path, body, "Range: bytes=0-0\r\nIf-Range: \"x\"\r\n");
+		check(0 == hdrs.find("HTTP/1.1 200 "));
+		check(body.size() > 1);
+	}
+
+	// precompressed sidecar files:
+	{
+		std::string body;
+		std::string hdrs = get(saddr, "/app.js", body);
+		check(0 == hdrs.find("HTTP/1.1 200 OK\r\n"));
+		check(std::string::npos != hdrs.find("\r\nVary: accept-encoding\r\n"));
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		check(body == "identity");
+		size_t type_pos = hdrs.find("\r\nContent-Type: ");
+		std::string const type = std::string::npos == type_pos ? std::string() :
+			hdrs.substr(type_pos, hdrs.find("\r\n", type_pos + 2) - type_pos);
+
+		hdrs = get(saddr, "/app.js", body, "Accept-Encoding: gzip, deflate, br\r\n");
+		check(std::string::npos != hdrs.find("\r\nContent-Encoding: br\r\n"));
+		check(std::string::npos != hdrs.find("\r\nVary: accept-encoding\r\n"));
+		check(type.empty() || std::string::npos != hdrs.find(type + "\r\n"));
+		check(body == "br");
+
+		hdrs = get(saddr, "/app.js", body, "Accept-Encoding: gzip\r\n");
+		check(std::string::npos != hdrs.find("\r\nContent-Encoding: gzip\r\n"));
+		check(body == "gzip");
+
+		hdrs = get(saddr, "/app.js", body, "Accept-Encoding: br;q=0.5, gzip\r\n");
+		check(std::string::npos != hdrs.find("\r\nContent-Encoding: gzip\r\n"));
+		check(body == "gzip");
+
+		hdrs = get(saddr, "/app.js", body, "Accept-Encoding: gzip;q=0.5\r\n");
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		check(body == "identity");
+
+		hdrs = get(saddr, "/only_gz.js", body, "Accept-Encoding: br, gzip\r\n");
+		check(std::string::npos != hdrs.find("\r\nContent-Encoding: gzip\r\n"));
+		check(body == "gzip");
+
+		hdrs = get(saddr, "/small.txt", body, "Accept-Encoding: br, gzip\r\n");
+		check(std::string::npos == hdrs.find("\r\nVary: "));
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		check(body == small_content);
+	}
+
+	// missing file:
+	{
+		std::string body;
+		std::string hdrs = get(saddr, "/missing.txt", body);
+		check(0 == hdrs.find("HTTP/1.1 404 "));
+	}
+
+	// shutdown:
+	s.terminate();
+	thrd.join();
+	boost::filesystem::remove_all(root);
 }
 
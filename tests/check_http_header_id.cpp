@@ -0,0 +1,76 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_message.hpp"
+#include <cctype>
+
+using namespace clane;
+
+int main() {
+
+	// every well-known name, in any case:
+	for (size_t i = 0; i < static_cast<size_t>(http::header_id::unknown); ++i) {
+		http::header_id const id = static_cast<http::header_id>(i);
+		std::string const name = http::header_name(id);
+		check(http::canonize_1x_header_name(name) == name);
+		check(id == http::find_header_id(name));
+		std::string s = name;
+		for (auto j = s.begin(); j != s.end(); ++j)
+			*j = std::tolower(*j);
+		check(id == http::find_header_id(s));
+		for (auto j = s.begin(); j != s.end(); ++j)
+			*j = std::toupper(*j);
+		check(id == http::find_header_id(s));
+		check(i == http::header_name_hash(s));
+
+		// near misses:
+		check(http::header_id::unknown == http::find_header_id(s.substr(0, s.size()-1)));
+		check(http::header_id::unknown == http::find_header_id(s + "x"));
+		s[s.size()/2] = '_';
+		check(http::header_id::unknown == http::find_header_id(s));
+	}
+	check(http::header_id::content_length == http::find_header_id("Content-Length"));
+	check(http::header_id::te == http::find_header_id("te"));
+	check(http::header_id::unknown == http::find_header_id(""));
+	check(http::header_id::unknown == http::find_header_id("t"));
+	check(http::header_id::unknown == http::find_header_id("x-alpha"));
+	check(http::header_id::unknown == http::find_header_id("content-lenGTX"));
+	check(nullptr == http::header_name(http::header_id::unknown));
+	check(http::header_name_hash("x-alpha") >= static_cast<size_t>(http::header_id::unknown));
+	check(http::header_name_hash("x-alpha") == http::header_name_hash("X-Alpha"));
+
+	// spelling:
+	{
+		std::string s("alpha");
+		http::append_1x_header_name(s, http::header_id::content_type, "content-TYPE");
+		http::append_1x_header_name(s, http::header_id::unknown, "x-bravo-CHARLIE");
+		check(s == "alphaContent-TypeX-Bravo-Charlie");
+	}
+
+	// header map lookups by ID:
+	{
+		http::header_map h{
+			http::header("x-alpha", "bravo"),
+			http::header("Content-Length", "12"),
+			http::header("vary", "charlie"),
+			http::header("VARY", "delta")};
+		check(h.find(http::header_id::content_length) == h.find("content-length"));
+		check(h.find(http::header_id::content_length)->second == "12");
+		check(h.id(h.find("content-length")) == http::header_id::content_length);
+		check(h.id(h.find("x-alpha")) == http::header_id::unknown);
+		check(h.find(http::header_id::host) == h.end());
+		check(h.find(http::header_id::unknown) == h.end());
+		check(2 == h.count(http::header_id::vary));
+		check(0 == h.count(http::header_id::unknown));
+		auto r = h.equal_range(http::header_id::vary);
+		check(r == h.equal_range("Vary"));
+		check(r.first->second == "charlie");
+		check((r.first+1)->second == "delta");
+		check(1 == h.count("X-ALPHA"));
+		check(0 == h.erase(http::header_id::unknown));
+		check(2 == h.erase(http::header_id::vary));
+		check(0 == h.count("vary"));
+		check(2 == h.size());
+		check(h.find(http::header_id::content_length)->second == "12");
+	}
+}
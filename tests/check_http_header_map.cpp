@@ -54,5 +54,63 @@ int main() {
 	check(!(charlie > delta));
 	check(!(charlie >= delta));
 
+	// order: by name, case-insensitive, and then by insertion
+	{
+		http::header_map h;
+		h.insert(http::header("Vary", "a"));
+		h.emplace("content-type", "text/plain");
+		h.insert(http::header("vary", "b"));
+		h.insert(http::header("Accept", "*/*"));
+		h.insert(http::header("VARY", "c"));
+		std::string s;
+		for (auto i = h.begin(); i != h.end(); ++i)
+			s += i->first + "=" + i->second + ";";
+		check(s == "Accept=*/*;content-type=text/plain;Vary=a;vary=b;VARY=c;");
+		check(5 == h.size());
+		check(3 == h.count("vary"));
+		check(0 == h.count("host"));
+		auto r = h.equal_range("vArY");
+		check(3 == r.second - r.first);
+		check("a" == r.first->second);
+		check(h.find("CONTENT-TYPE") != h.end() && "text/plain" == h.find("content-type")->second);
+		check(h.find("content") == h.end());
+		auto e = h.equal_range("host");
+		check(e.first == e.second);
+
+		// erase:
+		check(3 == h.erase("vary"));
+		check(2 == h.size());
+		auto p = h.erase(h.find("accept"));
+		check(p == h.begin() && "content-type" == p->first);
+		check(0 == h.erase("vary"));
+		h.clear();
+		check(h.empty());
+	}
+
+	// more headers than fit in place, and copying and moving
+	{
+		http::header_map h;
+		for (int i = 0; i < 100; ++i)
+			h.insert(http::header("x-" + std::to_string(i % 40), std::to_string(i)));
+		check(100 == h.size());
+		check(3 == h.count("X-7"));
+		check("87" == (h.equal_range("x-7").first + 2)->second);
+		http::header_map copy(h);
+		check(copy == h);
+		http::header_map moved(std::move(copy));
+		check(moved == h);
+		check(copy.empty());
+		http::header_map small{http::header("alpha", "bravo")};
+		http::header_map small_moved(std::move(small));
+		check(small.empty());
+		check(1 == small_moved.size() && "bravo" == small_moved.find("alpha")->second);
+		small_moved.swap(moved);
+		check(small_moved == h);
+		check(1 == moved.size());
+		moved = small_moved;
+		check(moved == h);
+		moved = http::header_map{http::header("charlie", "delta")};
+		check(1 == moved.size() && "delta" == moved.find("charlie")->second);
+	}
 }
 
@@ -0,0 +1,92 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_server.hpp"
+#include "../clane_http_route.hpp"
+
+using namespace clane;
+
+static void handler(http::response_ostream &rs, http::request &req, char const *s) {
+	rs << s;
+}
+
+static std::function<void(http::response_ostream &, http::request &)> make_handler(char const *s) {
+	return std::bind(handler, std::placeholders::_1, std::placeholders::_2, s);
+}
+
+int main() {
+
+	// normalization:
+	check(http::normalize_host("example.com") == "example.com");
+	check(http::normalize_host("Example.COM") == "example.com");
+	check(http::normalize_host("example.com:8080") == "example.com");
+	check(http::normalize_host("example.com.") == "example.com");
+	check(http::normalize_host("example.com.:80") == "example.com");
+	check(http::normalize_host("[::1]:8080") == "[::1]");
+	check(http::normalize_host("[::1]") == "[::1]");
+	check(http::normalize_host("127.0.0.1:80") == "127.0.0.1");
+	check(http::normalize_host("") == "");
+
+	http::host_router hr;
+	hr.new_host("example.com").new_route(make_handler("example")).path("^/$");
+	hr.new_host("*.example.com").new_route(make_handler("wild"));
+	hr.new_host("*.API.example.com").new_route(make_handler("wild api"));
+	hr.new_host("www.example.com").new_route(make_handler("www"));
+
+	std::ostringstream reqss(std::ios_base::in | std::ios_base::out);
+	http::request req(reqss.rdbuf());
+	req.method = "GET";
+	req.uri = uri::parse_uri_reference("/");
+	req.major_version = 1;
+	req.minor_version = 1;
+	auto dispatch = [&](char const *host) {
+		req.headers.clear();
+		if (host)
+			req.headers.insert(http::header("host", host));
+		http::response_record rr;
+		hr(rr.record(), req);
+		return rr.status == http::status_code::ok ? rr.body.str() :
+			std::to_string(static_cast<int>(rr.status));
+	};
+
+	check(dispatch("example.com") == "example");
+	check(dispatch("EXAMPLE.com:8080") == "example");
+	check(dispatch("www.example.com") == "www");
+	check(dispatch("a.example.com") == "wild");
+	check(dispatch("a.b.example.com") == "wild");
+	check(dispatch("v1.api.example.com") == "wild api");
+	check(dispatch("api.example.com") == "wild");
+	check(dispatch("example.org") == "404");
+	check(dispatch("notexample.com") == "404");
+	check(dispatch(nullptr) == "404");
+
+	// the per-host router decides the rest:
+	req.uri = uri::parse_uri_reference("/other");
+	check(dispatch("example.com") == "404");
+	check(dispatch("a.example.com") == "wild");
+	req.uri = uri::parse_uri_reference("/");
+
+	// default host:
+	hr.new_host("*").new_route(make_handler("default"));
+	check(dispatch("example.org") == "default");
+	check(dispatch(nullptr) == "default");
+	check(dispatch("example.com") == "example");
+
+	// more than one host:
+	req.headers.clear();
+	req.headers.insert(http::header("host", "example.com"));
+	req.headers.insert(http::header("host", "example.org"));
+	{
+		http::response_record rr;
+		hr(rr.record(), req);
+		check(rr.status == http::status_code::bad_request);
+	}
+
+	// replacing a host:
+	http::router r;
+	r.new_route(make_handler("replaced"));
+	hr.new_host("example.com", std::move(r));
+	check(dispatch("example.com") == "replaced");
+	check(hr.find("Example.com.") == hr.find("example.com"));
+	check(hr.find("x.example.com") != hr.find("example.com"));
+}
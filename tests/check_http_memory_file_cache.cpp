@@ -0,0 +1,115 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_file.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+
+using namespace clane;
+
+int main() {
+
+	char tmpl[] = "/tmp/check_http_memory_file_cache.XXXXXX";
+	check(::mkdtemp(tmpl));
+	boost::filesystem::path root(tmpl);
+	std::string const a = (root / "a.txt").string();
+	std::string const b = (root / "b.txt").string();
+	std::string const c = (root / "c.txt").string();
+	std::string const big = (root / "big.txt").string();
+	boost::filesystem::ofstream(a) << std::string(100, 'a');
+	boost::filesystem::ofstream(b) << std::string(100, 'b');
+	boost::filesystem::ofstream(c) << std::string(100, 'c');
+	boost::filesystem::ofstream(big) << std::string(1000, 'x');
+
+	// Backdate the files so that their entity tags are strong.
+	std::time_t const past = std::time(nullptr) - 60;
+	boost::filesystem::last_write_time(a, past);
+	boost::filesystem::last_write_time(b, past);
+	boost::filesystem::last_write_time(c, past);
+	boost::filesystem::last_write_time(big, past);
+
+	// An entry holds the file's body and its rendered content headers.
+	{
+		http::memory_file_cache cache(1000, 500);
+		auto ent = cache.lookup(a, *http::file_cache::load(a));
+		check(ent);
+		check(ent->body == std::string(100, 'a'));
+		check(std::string::npos != ent->header_lines.find("Content-Length: 100\r\n"));
+		check(ent->headers.find("content-length")->second == "100");
+		check(ent == cache.lookup(a, *http::file_cache::load(a)));
+		check(1 == cache.size());
+	}
+
+	// Files larger than the maximum file size aren't held in memory.
+	{
+		http::memory_file_cache cache(10000, 500);
+		check(!cache.lookup(big, *http::file_cache::load(big)));
+		check(!cache.lookup(root.string(), *http::file_cache::load(root.string())));
+		check(0 == cache.size());
+	}
+
+	// The least recently used entries go first once the byte budget is spent.
+	{
+		http::memory_file_cache cache(600, 500);
+		auto ea = cache.lookup(a, *http::file_cache::load(a));
+		auto eb = cache.lookup(b, *http::file_cache::load(b));
+		check(2 == cache.size());
+		check(ea == cache.lookup(a, *http::file_cache::load(a))); // a is now most recent
+		auto ec = cache.lookup(c, *http::file_cache::load(c));
+		check(2 == cache.size());
+		check(cache.bytes() <= 600);
+		check(ea == cache.lookup(a, *http::file_cache::load(a)));
+		check(ec == cache.lookup(c, *http::file_cache::load(c)));
+		check(eb != cache.lookup(b, *http::file_cache::load(b)));
+	}
+
+	// An entry is reloaded once the file changes.
+	{
+		http::memory_file_cache cache(1000, 500);
+		auto ent = cache.lookup(a, *http::file_cache::load(a));
+		size_t const old_bytes = cache.bytes();
+		boost::filesystem::ofstream(a) << std::string(50, 'A');
+		auto ent2 = cache.lookup(a, *http::file_cache::load(a));
+		check(ent2 != ent);
+		check(ent2->body == std::string(50, 'A'));
+		check(1 == cache.size());
+		check(cache.bytes() < old_bytes);
+	}
+
+	// An entry whose entity tag is weak is reloaded once the tag would be
+	// strong.
+	{
+		http::memory_file_cache cache(1000, 500);
+		http::file_cache::entry file = *http::file_cache::load(b);
+		file.mtime.tv_sec = std::time(nullptr);
+		auto ent = cache.lookup(b, file);
+		check(ent->weak_etag);
+		check(!ent->headers.find("etag")->second.compare(0, 2, "W/"));
+		check(ent == cache.lookup(b, file));
+		std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+		auto ent2 = cache.lookup(b, file);
+		check(ent2 != ent);
+		check(!ent2->weak_etag);
+		check(ent2->headers.find("etag")->second == http::file_etag(file));
+		check(ent2 == cache.lookup(b, file));
+	}
+
+	// A recorded response receives the body and content headers.
+	{
+		http::file_server fs(root, 16, std::chrono::seconds(60), 1000, 500);
+		std::istringstream req_body;
+		http::request req(req_body.rdbuf());
+		req.method = "GET";
+		req.uri = uri::parse_uri_reference("/b.txt");
+		http::response_record rr;
+		fs(rr.record(), req);
+		check(http::status_code::ok == rr.status);
+		check(rr.headers.find("content-length")->second == "100");
+		check(rr.body.str() == std::string(100, 'b'));
+	}
+
+	boost::filesystem::remove_all(root);
+}
+
@@ -0,0 +1,60 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_file.hpp"
+
+using namespace clane;
+
+static bool ranges_eq(std::vector<http::byte_range> const &got, std::vector<http::byte_range> const &exp) {
+	if (got.size() != exp.size())
+		return false;
+	for (size_t i = 0; i < got.size(); ++i) {
+		if (got[i].first != exp[i].first || got[i].last != exp[i].last)
+			return false;
+	}
+	return true;
+}
+
+int main() {
+
+	std::vector<http::byte_range> r;
+
+	// single ranges:
+	check(http::parse_byte_ranges("bytes=0-499", 1000, r));
+	check(ranges_eq(r, {{0, 499}}));
+	check(http::parse_byte_ranges("bytes=500-", 1000, r));
+	check(ranges_eq(r, {{500, 999}}));
+	check(http::parse_byte_ranges("bytes=-200", 1000, r));
+	check(ranges_eq(r, {{800, 999}}));
+	check(http::parse_byte_ranges("bytes=-2000", 1000, r));
+	check(ranges_eq(r, {{0, 999}}));
+	check(http::parse_byte_ranges("bytes=900-2000", 1000, r));
+	check(ranges_eq(r, {{900, 999}}));
+
+	// multiple ranges, with optional whitespace and empty elements:
+	check(http::parse_byte_ranges("bytes=0-0, -1", 1000, r));
+	check(ranges_eq(r, {{0, 0}, {999, 999}}));
+	check(http::parse_byte_ranges("bytes=, 1-2 ,,4-5", 1000, r));
+	check(ranges_eq(r, {{1, 2}, {4, 5}}));
+
+	// unsatisfiable ranges are dropped:
+	check(http::parse_byte_ranges("bytes=1000-1100", 1000, r));
+	check(r.empty());
+	check(http::parse_byte_ranges("bytes=-0", 1000, r));
+	check(r.empty());
+	check(http::parse_byte_ranges("bytes=0-10", 0, r));
+	check(r.empty());
+	check(http::parse_byte_ranges("bytes=2000-, 5-6", 1000, r));
+	check(ranges_eq(r, {{5, 6}}));
+
+	// headers to ignore:
+	check(!http::parse_byte_ranges("", 1000, r));
+	check(!http::parse_byte_ranges("bytes=", 1000, r));
+	check(!http::parse_byte_ranges("items=0-1", 1000, r));
+	check(!http::parse_byte_ranges("bytes=5-4", 1000, r));
+	check(!http::parse_byte_ranges("bytes=-", 1000, r));
+	check(!http::parse_byte_ranges("bytes=a-b", 1000, r));
+	check(!http::parse_byte_ranges("bytes=0-1;2-3", 1000, r));
+	check(!http::parse_byte_ranges("bytes=99999999999999999999-", 1000, r));
+}
+
@@ -29,5 +29,7 @@ int main() {
 	check_nok("200a");
 	check_nok("-200");
 	check_nok("1234");
+	check_nok("+200");
+	check_nok("99999999999999999999");
 }
 
@@ -24,6 +24,8 @@ using namespace clane;
 int main() {
 	check_ok("HTTP/1.0", 1, 0);
 	check_ok("HTTP/1.1", 1, 1);
+	check_ok("HTTP/12.345", 12, 345);
+	check_ok("HTTP/01.01", 1, 1);
 	check_nok("");
 	check_nok("HTTP");
 	check_nok("HTTP/");
@@ -33,5 +35,12 @@ int main() {
 	check_nok(" HTTP/1.1");
 	check_nok("HTTP/-1.1");
 	check_nok("HTTP/1.-1");
+	check_nok("HTTP/+1.1");
+	check_nok("HTTP/1.+1");
+	check_nok("HTTP/.1");
+	check_nok("HTTP/1.1.1");
+	check_nok("HTTP/1 .1");
+	check_nok("HTTP/2147483648.0");
+	check_nok("HTTP/1.99999999999999999999");
 }
 
@@ -11,17 +11,17 @@ int main() {
 
 	check(!http::query_headers_chunked(h));
 
-	auto p = h.insert(http::header_map::value_type("transfer-encoding", "chunked"));
+	h.insert(http::header_map::value_type("transfer-encoding", "chunked"));
 	check(http::query_headers_chunked(h));
 
 	h.insert(http::header_map::value_type("content-length", "0"));
 	check(http::query_headers_chunked(h));
 
-	h.erase(p);
+	h.erase(h.find("transfer-encoding"));
 	check(!http::query_headers_chunked(h));
 
 	// case-insensitivity
-	p = h.insert(http::header_map::value_type("Transfer-Encoding", "chunked"));
+	h.insert(http::header_map::value_type("Transfer-Encoding", "chunked"));
 	check(http::query_headers_chunked(h));
 }
 
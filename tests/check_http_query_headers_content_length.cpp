@@ -31,5 +31,14 @@ int main() {
 
 	p = h.insert(http::header_map::value_type("content-length", "invalid"));
 	check(!http::query_headers_content_length(h, len));
+	h.erase(p);
+	p = h.insert(http::header_map::value_type("content-length", "-1"));
+	check(!http::query_headers_content_length(h, len));
+	h.erase(p);
+	p = h.insert(http::header_map::value_type("content-length", "1234x"));
+	check(!http::query_headers_content_length(h, len));
+	h.erase(p);
+	p = h.insert(http::header_map::value_type("content-length", "99999999999999999999999"));
+	check(!http::query_headers_content_length(h, len));
 }
 
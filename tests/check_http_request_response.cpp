@@ -63,7 +63,7 @@ int main() {
 		resp += std::string(buf, xstat);
 	}
 	check_v1x_response(resp, 1, 1, http::status_code::ok, "OK",
-			http::header_map{http::header("content-type", "text/plain"), http::header("transfer-encoding", "chunked")},
+			http::header_map{http::header("content-type", "text/plain"), http::header("content-length", "19")},
 			"Hello, from Clane!\n",
 			http::header_map{});
 
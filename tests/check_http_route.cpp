@@ -31,6 +31,25 @@ int main() {
 	check(http::route().method("GET").match(req));
 	check(http::route().method("ET").match(req));
 	check(!http::route().method("POST").match(req));
+	check(http::route().method("^(GET|HEAD)$").match(req));
+	check(!http::route().method("^(POST|PUT)$").match(req));
+
+	// method set
+	check(http::route().method(http::method_get).match(req));
+	check(http::route().method(http::method_get | http::method_post).match(req));
+	check(!http::route().method(http::method_post).match(req));
+	check(!http::route().method(http::method_other).match(req));
+	req.method_id = http::method_get;
+	check(http::route().method(http::method_get).match(req));
+	check(http::route().method("^GET$").match(req));
+	req.method = "PURGE";
+	req.method_id = http::method_other;
+	check(http::route().method(http::method_other).match(req));
+	check(!http::route().method(http::method_any & ~http::method_other).match(req));
+	check(http::route().method("^PURGE$").match(req));
+	check(!http::route().method("^(GET|LINK)$").match(req));
+	req.method = "GET";
+	req.method_id = 0;
 
 	// host
 	check(http::route().host("foobar").match(req));
@@ -44,6 +63,21 @@ int main() {
 	check(http::route().path("/bravo").match(req));
 	check(!http::route().path("^/bravo").match(req));
 
+	// path parameters
+	check(http::route().path("^/{first}/{second}$").match(req));
+	check(2 == req.path_params.size());
+	check(req.find_path_param("first") && req.find_path_param("first")->str() == "alpha");
+	check(req.find_path_param("second") && req.find_path_param("second")->str() == "bravo");
+	check(req.find_path_param("second")->data == req.uri.path.data() + 7);
+	check(!req.find_path_param("third"));
+	req.path_params.clear();
+	check(!http::route().path("^/{first}$").match(req));
+	check(!http::route().path("^/{first}/{second}$").header("delta", "nope").match(req));
+	check(req.path_params.empty());
+	http::request const &const_req = req;
+	check(http::route().path("^/alpha/{second}$").match(const_req));
+	check(req.path_params.empty());
+
 	// header
 	check(http::route().header("delta", "echo").match(req));
 	check(http::route().header("delta", "fox").match(req));
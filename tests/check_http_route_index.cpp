@@ -0,0 +1,148 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_route.hpp"
+
+using namespace clane;
+
+static bool is_literal(std::string const &pattern, http::route_literal::kind_type kind, std::string const &text,
+	regex::options_type reopts = regex::options::normal) {
+	auto lit = http::analyze_route_pattern(pattern, reopts);
+	return lit.kind == kind && lit.text == text;
+}
+
+static http::route_literal lit(std::string const &pattern) {
+	return http::analyze_route_pattern(pattern, regex::options::normal);
+}
+
+static bool is_method_set(std::string const &pattern, http::method_set exp_methods, bool exp_exact,
+	regex::options_type reopts = regex::options::normal) {
+	bool exact;
+	http::method_set methods = http::analyze_method_pattern(pattern, reopts, &exact);
+	return methods == exp_methods && exact == exp_exact;
+}
+
+static bool is_template(std::string const &pattern, std::string const &exp_regex, bool exp_literal,
+	std::vector<std::string> const &exp_texts = {}) {
+	http::route_path_template t;
+	return http::parse_route_path_template(pattern, &t) && t.regex == exp_regex && t.literal == exp_literal &&
+		t.texts == exp_texts;
+}
+
+static std::string match_path(std::string const &pattern, std::string const &path) {
+	http::route_path_template t;
+	http::parse_route_path_template(pattern, &t);
+	boost::regex re(t.regex);
+	std::vector<http::path_param> params;
+	if (!http::match_route_path(path, re, http::route_literal{http::route_literal::none, std::string()}, t,
+		&params))
+		return "none";
+	std::string s;
+	for (auto i = params.begin(); i != params.end(); ++i)
+		s += i->name + "=" + i->str() + ";";
+	return s;
+}
+
+static bool found(std::vector<size_t> const *got, std::vector<size_t> const &exp) {
+	return got && *got == exp;
+}
+
+int main() {
+
+	// pattern analysis:
+	check(is_literal("", http::route_literal::prefix, ""));
+	check(is_literal("^", http::route_literal::prefix, ""));
+	check(is_literal("^/static/", http::route_literal::prefix, "/static/"));
+	check(is_literal("^/count$", http::route_literal::exact, "/count"));
+	check(is_literal("^GET$", http::route_literal::exact, "GET"));
+	check(is_literal("^/a\\.b\\$$", http::route_literal::exact, "/a.b$"));
+	check(is_literal("a.b", http::route_literal::substring, "a.b", regex::options::literal));
+	check(is_literal("/count", http::route_literal::none, ""));
+	check(is_literal("^/a.b$", http::route_literal::none, ""));
+	check(is_literal("^/a\\d$", http::route_literal::none, ""));
+	check(is_literal("^/a(b)$", http::route_literal::none, ""));
+	check(is_literal("^/a$b", http::route_literal::none, ""));
+	check(is_literal("^/a\\", http::route_literal::none, ""));
+	check(is_literal("^/a\\>", http::route_literal::none, ""));
+	check(is_literal("^\\</a", http::route_literal::none, ""));
+	check(is_literal("^/a\\'", http::route_literal::none, ""));
+	check(is_literal("^\\`/a", http::route_literal::none, ""));
+
+	// method pattern analysis:
+	check(is_method_set("", http::method_any, true));
+	check(is_method_set("^GET$", http::method_get, true));
+	check(is_method_set("^(GET|HEAD)$", http::method_get | http::method_head, true));
+	check(is_method_set("^(?:PUT|PATCH)$", http::method_put | http::method_patch, true));
+	check(is_method_set("^(GET|PURGE)$", http::method_get | http::method_other, false));
+	check(is_method_set("^PURGE$", http::method_other, false));
+	check(is_method_set("^get$", http::method_other, false));
+	check(is_method_set("GET", http::method_any, false));
+	check(is_method_set("^GET", http::method_any, false));
+	check(is_method_set("^G.T$", http::method_any, false));
+	check(is_method_set("^(GET|)$", http::method_any, false));
+	check(is_method_set("^GET|POST$", http::method_any, false));
+	check(is_method_set("^(GET)|(POST)$", http::method_any, false));
+	check(is_method_set("^GET$", http::method_any, false, regex::options::literal));
+
+	// path templates:
+	http::route_path_template t;
+	check(!http::parse_route_path_template("^/users$", &t));
+	check(!http::parse_route_path_template("^/a{2}$", &t));
+	check(!http::parse_route_path_template("^/a\\{id}$", &t));
+	check(!http::parse_route_path_template("^/[{id}]$", &t));
+	check(is_template("^/users/{id}$", "^/users/(?<id>[^/]+)$", true, {"/users/", ""}));
+	check(is_template("^/a\\>/{id}$", "^/a\\>/(?<id>[^/]+)$", false));
+	check(is_template("^/u/{id}/p/{post}", "^/u/(?<id>[^/]+)/p/(?<post>[^/]+)", true, {"/u/", "/p/", ""}));
+	check(is_template("^/a\\.b/{x_1}/", "^/a\\.b/(?<x_1>[^/]+)/", true, {"/a.b/", "/"}));
+	check(is_template("^/files/{name}\\.json$", "^/files/(?<name>[^/]+)\\.json$", false));
+	check(is_template("/users/{id}$", "/users/(?<id>[^/]+)$", false));
+	check(is_template("^/(v1|v2)/{id}$", "^/(v1|v2)/(?<id>[^/]+)$", false));
+	check(match_path("^/users/{id}$", "/users/42") == "id=42;");
+	check(match_path("^/users/{id}$", "/users/42/") == "none");
+	check(match_path("^/users/{id}$", "/users/") == "none");
+	check(match_path("^/users/{id}", "/users/42/x") == "id=42;");
+	check(match_path("^/u/{id}/p/{post}$", "/u/7/p/abc") == "id=7;post=abc;");
+	check(match_path("^/u/{id}/p/{post}$", "/u/7/q/abc") == "none");
+	check(match_path("^/files/{name}\\.json$", "/files/a.b.json") == "name=a.b;");
+	check(match_path("/users/{id}$", "/api/users/9") == "id=9;");
+	check(match_path("^/(v1|v2)/{id}$", "/v2/x") == "id=x;");
+	check(match_path("^/users/{id}$", "/users/4\n2") == "id=4\n2;");
+
+	// safe strings:
+	check(http::is_route_literal_safe("/alpha/bravo?x=1"));
+	check(!http::is_route_literal_safe("/alpha\n/bravo"));
+	check(!http::is_route_literal_safe("/caf\xc3\xa9"));
+
+	// index:
+	http::route_index index;
+	index.add(0, http::method_get, lit("^/users$"));
+	index.add(1, http::method_any, lit("^/users/"));
+	index.add(2, http::method_post, lit("^/users$"));
+	index.add(3, http::method_get, lit("/[0-9]+$"));
+	index.add(4, http::method_get, lit("^/use"));
+	index.add(5, http::method_get | http::method_head, lit("^/users$"));
+	index.add(6, http::method_any, lit(""));
+	index.add(7, http::method_get, lit("^/users/me$"));
+	index.add(8, http::method_other, lit("^/users$"));
+	index.finish();
+	check(found(index.find(http::method_get, "/users"), {0, 3, 4, 5, 6}));
+	check(found(index.find(http::method_get, "/users/"), {1, 3, 4, 6}));
+	check(found(index.find(http::method_get, "/users/me"), {1, 3, 4, 6, 7}));
+	check(found(index.find(http::method_get, "/users/med"), {1, 3, 4, 6}));
+	check(found(index.find(http::method_get, "/us"), {3, 6}));
+	check(found(index.find(http::method_get, "/other"), {3, 6}));
+	check(found(index.find(http::method_get, ""), {3, 6}));
+	check(found(index.find(http::method_post, "/users"), {2, 6}));
+	check(found(index.find(http::method_head, "/users"), {5, 6}));
+	check(found(index.find(http::method_head, "/users/x"), {1, 6}));
+	check(found(index.find(http::method_other, "/users"), {6, 8}));
+	check(found(index.find(http::method_delete, "/users"), {6}));
+	check(!index.find(http::method_get, "/users\n"));
+	check(!index.find(0, "/users"));
+
+	// empty index:
+	http::route_index empty;
+	empty.finish();
+	check(found(empty.find(http::method_get, "/"), {}));
+}
+
@@ -0,0 +1,87 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_route.hpp"
+#include <thread>
+
+using namespace clane;
+
+int main() {
+
+	std::vector<http::path_param> params;
+	size_t route;
+
+	// hit and miss:
+	{
+		http::route_match_cache cache(64);
+		check(!cache.find("GET", "example.com", "/alpha", &route, &params));
+		cache.insert("GET", "example.com", "/alpha", 3, params, 0);
+		check(cache.find("GET", "example.com", "/alpha", &route, &params));
+		check(3 == route);
+		check(params.empty());
+		check(!cache.find("POST", "example.com", "/alpha", &route, &params));
+		check(!cache.find("GET", "example.org", "/alpha", &route, &params));
+		check(!cache.find("GET", "example.com", "/alpha/", &route, &params));
+		cache.insert("GET", "", "/nowhere", http::route_match_cache::no_route, params, 0);
+		check(cache.find("GET", "", "/nowhere", &route, &params));
+		check(http::route_match_cache::no_route == route);
+		check(2 == cache.hits());
+		check(4 == cache.misses());
+		cache.clear();
+		check(!cache.find("GET", "example.com", "/alpha", &route, &params));
+	}
+
+	// Path parameters are views into the path of the request that finds
+	// them.
+	{
+		http::route_match_cache cache(64);
+		std::string const path1 = "/users/42/posts/7";
+		params.push_back(http::path_param{"other", path1.data(), 1});
+		params.push_back(http::path_param{"id", path1.data() + 7, 2});
+		params.push_back(http::path_param{"post", path1.data() + 16, 1});
+		cache.insert("GET", "", path1, 1, params, 1);
+		params.clear();
+		std::string const path2 = path1;
+		check(cache.find("GET", "", path2, &route, &params));
+		check(2 == params.size());
+		check("id" == params[0].name && "42" == params[0].str() && path2.data() + 7 == params[0].data);
+		check("post" == params[1].name && "7" == params[1].str() && path2.data() + 16 == params[1].data);
+		params.clear();
+	}
+
+	// bounded:
+	{
+		http::route_match_cache cache(16);
+		for (size_t i = 0; i < 1000; ++i)
+			cache.insert("GET", "", "/" + std::to_string(i), i, params, 0);
+		size_t found = 0;
+		for (size_t i = 0; i < 1000; ++i) {
+			if (cache.find("GET", "", "/" + std::to_string(i), &route, &params)) {
+				check(i == route);
+				++found;
+			}
+		}
+		check(found <= 16);
+	}
+
+	// concurrent:
+	{
+		http::route_match_cache cache(256);
+		auto work = [&cache](size_t seed) {
+			std::vector<http::path_param> params;
+			for (size_t i = 0; i < 10000; ++i) {
+				std::string const path = "/" + std::to_string((i * 7 + seed) % 100);
+				size_t route;
+				if (cache.find("GET", "", path, &route, &params))
+					check(path == "/" + std::to_string(route));
+				else
+					cache.insert("GET", "", path, std::stoul(path.substr(1)), params, 0);
+			}
+		};
+		std::thread t1(work, 1), t2(work, 2), t3(work, 3);
+		t1.join();
+		t2.join();
+		t3.join();
+		check(30000 == cache.hits() + cache.misses());
+	}
+}
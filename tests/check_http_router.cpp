@@ -61,5 +61,117 @@ int main() {
 		check(rr.status == http::status_code::not_found);
 	}
 
+	// The first matching route wins, whether its criteria are literal or
+	// regular expressions.
+	{
+		http::router r;
+		r.new_route(make_handler("0")).method("^POST$").path("^/alpha/bravo$");
+		r.new_route(make_handler("1")).method("^GET$").path("^/alpha/charlie$");
+		r.new_route(make_handler("2")).method("^GET$").path("^/alpha/bravo$").header("delta", "nope");
+		r.new_route(make_handler("3")).method("G.T").path("^/alpha/b");
+		r.new_route(make_handler("4")).method("^GET$").path("^/alpha/bravo$");
+		r.new_route(make_handler("5")).path("bravo");
+		r.new_route(make_handler("6")).method(http::method_put | http::method_patch).path("^/alpha/delta$");
+		r.new_route(make_handler("7")).method("^(PURGE|GET)$").path("^/alpha/delta$");
+		auto dispatch = [&](std::string const &method, std::string const &path) {
+			req.method = method;
+			req.method_id = http::parse_method(method);
+			req.uri = uri::parse_uri_reference(path);
+			req.path_params.clear();
+			http::response_record rr;
+			r(rr.record(), req);
+			return rr.status == http::status_code::ok ? rr.body.str() : std::string("none");
+		};
+		check(dispatch("GET", "/alpha/bravo") == "check: 3");
+		check(dispatch("POST", "/alpha/bravo") == "check: 0");
+		check(dispatch("GET", "/alpha/charlie") == "check: 1");
+		check(dispatch("PUT", "/x/bravo") == "check: 5");
+		check(dispatch("PUT", "/alpha/charlie") == "none");
+		check(dispatch("PATCH", "/alpha/delta") == "check: 6");
+		check(dispatch("PURGE", "/alpha/delta") == "check: 7");
+		check(dispatch("LINK", "/alpha/delta") == "none");
+		// A Perl-syntax anchor matches at a line break, so a path with a line
+		// break falls back to trying every route.
+		check(dispatch("GET", "/x%0A/alpha/bravo") == "check: 3");
+
+		// path parameters:
+		r.new_route([](http::response_ostream &rs, http::request &req) {
+			for (auto i = req.path_params.begin(); i != req.path_params.end(); ++i)
+				rs << i->name << '=' << i->str() << ';';
+		}).method(http::method_get).path("^/users/{id}/posts/{post}$");
+		check(dispatch("GET", "/users/12/posts/hello") == "id=12;post=hello;");
+		check(dispatch("GET", "/users/12/posts/") == "none");
+
+		// new routes invalidate the index:
+		r.new_route(make_handler("9")).path("^/alpha/charlie$");
+		check(dispatch("PUT", "/alpha/charlie") == "check: 9");
+	}
+
+	// The match cache remembers the matching route, if any, for requests whose
+	// routes don't depend on headers other than the host.
+	{
+		http::router r;
+		r.set_match_cache_capacity(64);
+		r.new_route(make_handler("0")).path("^/alpha$").header("delta", "nope");
+		r.new_route(make_handler("1")).method(http::method_get).host("^foobar$").path("^/bravo$");
+		r.new_route([](http::response_ostream &rs, http::request &req) {
+			for (auto i = req.path_params.begin(); i != req.path_params.end(); ++i)
+				rs << i->name << '=' << i->str() << ';';
+		}).path("^/users/{id}$");
+		req.method = "GET";
+		req.method_id = http::method_get;
+		auto dispatch = [&](std::string const &path) {
+			req.uri = uri::parse_uri_reference(path);
+			req.path_params.clear();
+			http::response_record rr;
+			r(rr.record(), req);
+			return rr.status == http::status_code::ok ? rr.body.str() : std::string("none");
+		};
+		check(dispatch("/bravo") == "check: 1");
+		check(0 == r.match_cache_hits() && 1 == r.match_cache_misses());
+		check(dispatch("/bravo") == "check: 1");
+		check(1 == r.match_cache_hits() && 1 == r.match_cache_misses());
+		check(dispatch("/users/7") == "id=7;");
+		check(dispatch("/users/7") == "id=7;");
+		check(1 == req.path_params.size() && req.path_params[0].data == req.uri.path.data() + 7);
+		check(dispatch("/nowhere") == "none");
+		check(dispatch("/nowhere") == "none");
+		check(3 == r.match_cache_hits() && 3 == r.match_cache_misses());
+
+		// not cached: a route depends on another header
+		check(dispatch("/alpha") == "none");
+		check(dispatch("/alpha") == "none");
+		check(3 == r.match_cache_hits() && 5 == r.match_cache_misses());
+
+		// not cached: more than one host
+		req.headers.insert(http::header("host", "foobar"));
+		check(dispatch("/bravo") == "check: 1");
+		check(3 == r.match_cache_hits() && 5 == r.match_cache_misses());
+		req.headers.erase(req.headers.equal_range("host").first);
+
+		// different host, different entry
+		req.headers.find("host")->second = "other";
+		check(dispatch("/bravo") == "none");
+		check(3 == r.match_cache_hits() && 6 == r.match_cache_misses());
+		req.headers.find("host")->second = "foobar";
+
+		// not cached: no host, which mustn't share an entry with an empty host
+		req.headers.erase(req.headers.find("host"));
+		check(dispatch("/bravo") == "none");
+		check(dispatch("/bravo") == "none");
+		check(3 == r.match_cache_hits() && 6 == r.match_cache_misses());
+		req.headers.insert(http::header("host", "foobar"));
+
+		// new routes invalidate the cache:
+		r.new_route(make_handler("3")).path("^/nowhere$");
+		check(dispatch("/nowhere") == "check: 3");
+		check(dispatch("/bravo") == "check: 1");
+		check(3 == r.match_cache_hits() && 8 == r.match_cache_misses());
+
+		r.set_match_cache_capacity(0);
+		check(dispatch("/bravo") == "check: 1");
+		check(0 == r.match_cache_hits() && 0 == r.match_cache_misses());
+	}
+
 }
 
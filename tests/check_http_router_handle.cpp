@@ -0,0 +1,122 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_server.hpp"
+#include "../clane_http_route.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+using namespace clane;
+
+static std::string dispatch(http::router_handle &h, std::string const &path) {
+	std::ostringstream reqss(std::ios_base::in | std::ios_base::out);
+	http::request req(reqss.rdbuf());
+	req.method = "GET";
+	req.uri = uri::parse_uri_reference(path);
+	req.major_version = 1;
+	req.minor_version = 1;
+	http::response_record rr;
+	h(rr.record(), req);
+	return rr.status == http::status_code::ok ? rr.body.str() : std::string("none");
+}
+
+// Returns a router whose one route responds with the given text. The route
+// holds a reference to the token, so that the token's use count reveals
+// whether the router still exists.
+static http::router make_router(std::string const &path, std::string const &text, std::shared_ptr<int> token) {
+	http::router r;
+	r.new_route([text, token](http::response_ostream &rs, http::request &) { rs << text; }).path(path);
+	return r;
+}
+
+int main() {
+
+	// publish:
+	{
+		http::router_handle h;
+		check(dispatch(h, "/alpha") == "none");
+		auto token1 = std::make_shared<int>();
+		h.publish(make_router("^/alpha$", "one", token1));
+		check(2 == token1.use_count());
+		check(dispatch(h, "/alpha") == "one");
+
+		// copies share the router:
+		http::router_handle h2 = h;
+		auto token2 = std::make_shared<int>();
+		h2.publish(make_router("^/alpha$", "two", token2));
+		check(dispatch(h, "/alpha") == "two");
+		check(1 == token1.use_count()); // old router reclaimed
+		check(2 == token2.use_count());
+	}
+
+	// A replaced router lives until its in-flight requests finish, and a
+	// request handler may itself publish a new router.
+	{
+		http::router_handle h;
+		std::mutex mutex;
+		std::condition_variable cond;
+		bool entered = false, proceed = false;
+		auto token = std::make_shared<int>();
+		http::router r;
+		r.new_route([&, token](http::response_ostream &rs, http::request &) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				entered = true;
+				cond.notify_all();
+				cond.wait(lock, [&]() { return proceed; });
+			}
+			rs << "slow";
+		}).path("^/slow$");
+		r.new_route([&h](http::response_ostream &rs, http::request &) {
+			h.publish(make_router("^/alpha$", "reloaded", nullptr));
+			rs << "reloading";
+		}).path("^/reload$");
+		h.publish(std::move(r));
+
+		std::string slow_result;
+		std::thread slow([&]() { slow_result = dispatch(h, "/slow"); });
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]() { return entered; });
+		}
+		check(dispatch(h, "/reload") == "reloading");
+		check(dispatch(h, "/alpha") == "reloaded");
+		check(dispatch(h, "/slow") == "none");
+		check(2 == token.use_count()); // still in use by the slow request
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			proceed = true;
+			cond.notify_all();
+		}
+		slow.join();
+		check(slow_result == "slow");
+		check(1 == token.use_count());
+	}
+
+	// concurrent dispatch and publish:
+	{
+		http::router_handle h;
+		auto token = std::make_shared<int>();
+		h.publish(make_router("^/alpha$", "0", token));
+		std::atomic<bool> done(false);
+		std::atomic<size_t> bad(0);
+		auto work = [&]() {
+			while (!done) {
+				std::string const s = dispatch(h, "/alpha");
+				if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos)
+					++bad;
+			}
+		};
+		std::thread t1(work), t2(work), t3(work);
+		for (int i = 1; i <= 1000; ++i)
+			h.publish(make_router("^/alpha$", std::to_string(i), token));
+		done = true;
+		t1.join();
+		t2.join();
+		t3.join();
+		check(0 == bad);
+		check(dispatch(h, "/alpha") == "1000");
+		check(2 == token.use_count());
+	}
+}
@@ -0,0 +1,68 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_server.hpp"
+#include "../clane_net_error.hpp"
+#include "../clane_net_inet.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+using namespace clane;
+
+// The server's listener runs out of descriptors for its first few accepts,
+// leaving the connection pending.
+static net::protocol_family emfile_tcp4;
+static std::atomic<int> emfile_count;
+
+static net::socket emfile_accept(net::socket_descriptor &sd, std::string *addr_o, std::error_code &e) {
+	if (0 < emfile_count--) {
+		e.assign(EMFILE, net::os_category());
+		return net::socket();
+	}
+	return net::tcp4.accept(sd, addr_o, e);
+}
+
+void handle(http::response_ostream &rs, http::request &req) {
+	rs << "hello";
+}
+
+int main() {
+
+	emfile_tcp4 = net::tcp4;
+	emfile_tcp4.accept = emfile_accept;
+	emfile_count = 3;
+
+	// run server:
+	http::server s;
+	s.root_handler = handle;
+	auto lis4 = net::listen(&net::tcp4, "127.0.0.1:");
+	std::string saddr = lis4.local_address();
+	s.add_listener(net::socket(&emfile_tcp4, posix::unique_fd(::dup(lis4.descriptor()))));
+	lis4 = net::socket();
+	std::thread thrd(&http::server::serve, &s);
+
+	// The server accepts the connection once descriptors are available again,
+	// even though no other connection arrives to signal the listener.
+	std::error_code e;
+	auto cli = net::connect(&net::tcp4, saddr, e);
+	check(!e);
+	static char const *R = "GET / HTTP/1.1\r\n\r\n";
+	cli.send(R, std::strlen(R), net::all, e);
+	check(!e);
+	std::string resp;
+	while (std::string::npos == resp.find("hello")) {
+		char buf[4096];
+		size_t xstat = cli.recv(buf, sizeof(buf), e);
+		check(!e);
+		check(xstat);
+		resp += std::string(buf, xstat);
+	}
+	check(0 > emfile_count);
+
+	// shutdown:
+	cli.fin();
+	s.terminate();
+	thrd.join();
+}
@@ -0,0 +1,235 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_file.hpp"
+#include "../clane_http_server.hpp"
+#include "../clane_mime.hpp"
+#include "../clane_net_inet.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+using namespace clane;
+
+static std::string json_body() {
+	std::string s = "[";
+	for (int i = 0; i < 1000; ++i)
+		s += "{\"id\": " + std::to_string(i) + ", \"name\": \"item\"},";
+	s += "{}]";
+	return s;
+}
+
+static std::unique_ptr<http::file_server> files;
+
+void handle(http::response_ostream &rs, http::request &req) {
+	std::string const &path = req.uri.path;
+	if (!path.compare(0, 7, "/files/")) {
+		(*files)(rs, req);
+	} else if (!path.compare(0, 7, "/typed/")) {
+		// The application's own content type keeps the file server from
+		// sending its prepared headers and body in one write.
+		rs.headers.insert(http::header("content-type", "text/plain"));
+		(*files)(rs, req);
+	} else if (path == "/json") {
+		rs.headers.insert(http::header("content-type", "application/json"));
+		rs.headers.insert(http::header("etag", "\"v1\""));
+		rs << json_body();
+	} else if (path == "/small") {
+		rs.headers.insert(http::header("content-type", "application/json"));
+		rs << "{}";
+	} else if (path == "/binary") {
+		rs.headers.insert(http::header("content-type", "image/png"));
+		rs << json_body();
+	} else if (path == "/encoded") {
+		rs.headers.insert(http::header("content-type", "text/plain"));
+		rs.headers.insert(http::header("content-encoding", "identity"));
+		rs << json_body();
+	} else if (path == "/flush") {
+		rs.headers.insert(http::header("content-type", "text/plain"));
+		rs << "hello" << std::flush << ", world";
+	}
+}
+
+// Sends a GET request and receives the response, undoing any chunked transfer
+// coding and gzip or deflate content coding.
+static std::string get(std::string const &saddr, std::string const &path, std::string const &extra_hdrs,
+	std::string &body) {
+	std::error_code e;
+	auto cli = net::connect(&net::tcp4, saddr, e);
+	check(!e);
+	std::string req = "GET " + path + " HTTP/1.1\r\n" + extra_hdrs + "\r\n";
+	cli.send(req.data(), req.size(), net::all, e);
+	check(!e);
+	cli.fin();
+	std::string resp;
+	while (true) {
+		char buf[65536];
+		size_t xstat = cli.recv(buf, sizeof(buf), e);
+		check(!e);
+		if (!xstat)
+			break;
+		resp += std::string(buf, xstat);
+	}
+	size_t hdrs_end = resp.find("\r\n\r\n");
+	check(std::string::npos != hdrs_end);
+	std::string hdrs = resp.substr(0, hdrs_end + 2);
+	body = resp.substr(hdrs_end + 4);
+
+	if (std::string::npos != hdrs.find("\r\nTransfer-Encoding: chunked\r\n")) {
+		std::string raw;
+		size_t pos = 0;
+		while (true) {
+			size_t line_end = body.find("\r\n", pos);
+			check(std::string::npos != line_end);
+			size_t n = std::stoul(body.substr(pos, line_end - pos), nullptr, 16);
+			if (!n)
+				break;
+			raw += body.substr(line_end + 2, n);
+			pos = line_end + 2 + n + 2;
+		}
+		body = raw;
+	}
+
+	if (std::string::npos != hdrs.find("\r\nContent-Encoding: gzip\r\n") ||
+		std::string::npos != hdrs.find("\r\nContent-Encoding: deflate\r\n")) {
+		z_stream zs{};
+		check(Z_OK == inflateInit2(&zs, 15 + 32)); // detect gzip or zlib header
+		zs.next_in = reinterpret_cast<Bytef *>(&body[0]);
+		zs.avail_in = body.size();
+		std::string out;
+		int zstat;
+		do {
+			char buf[4096];
+			zs.next_out = reinterpret_cast<Bytef *>(buf);
+			zs.avail_out = sizeof(buf);
+			zstat = inflate(&zs, Z_NO_FLUSH);
+			check(Z_OK == zstat || Z_STREAM_END == zstat);
+			out.append(buf, sizeof(buf) - zs.avail_out);
+		} while (Z_STREAM_END != zstat);
+		inflateEnd(&zs);
+		body = out;
+	}
+	return hdrs;
+}
+
+int main() {
+
+	char tmpl[] = "/tmp/check_http_server_compress.XXXXXX";
+	check(::mkdtemp(tmpl));
+	boost::filesystem::path root(tmpl);
+	boost::filesystem::create_directory(root / "files");
+	boost::filesystem::create_directory(root / "typed");
+	std::string text;
+	for (int i = 0; i < 100; ++i)
+		text += "line " + std::to_string(i) + "\n";
+	boost::filesystem::ofstream(root / "files" / "a.txt") << text;
+	boost::filesystem::ofstream(root / "typed" / "b.txt") << text;
+	files.reset(new http::file_server(root, 16, std::chrono::seconds(60), 100000, 65536));
+
+	// run server:
+	http::server s;
+	s.root_handler = handle;
+	s.compress_responses = true;
+	s.compression_min_size = 100;
+	auto lis = net::listen(&net::tcp, "localhost:");
+	std::string saddr = lis.local_address();
+	s.add_listener(std::move(lis));
+	std::thread thrd(&http::server::serve, &s);
+
+	std::string const json = json_body();
+	std::string body;
+
+	// gzip, more than once so that a thread reuses its zlib state:
+	for (int i = 0; i < 3; ++i) {
+		std::string hdrs = get(saddr, "/json", "Accept-Encoding: gzip, deflate\r\n", body);
+		check(0 == hdrs.find("HTTP/1.1 200 OK\r\n"));
+		check(std::string::npos != hdrs.find("\r\nContent-Encoding: gzip\r\n"));
+		check(std::string::npos != hdrs.find("\r\nVary: accept-encoding\r\n"));
+		check(std::string::npos != hdrs.find("\r\nEtag: W/\"v1\"\r\n"));
+		check(std::string::npos == hdrs.find("\r\nContent-Length: " + std::to_string(json.size()) + "\r\n"));
+		check(body == json);
+	}
+
+	// deflate:
+	{
+		std::string hdrs = get(saddr, "/json", "Accept-Encoding: deflate\r\n", body);
+		check(std::string::npos != hdrs.find("\r\nContent-Encoding: deflate\r\n"));
+		check(body == json);
+	}
+
+	// The client doesn't accept compression.
+	{
+		std::string hdrs = get(saddr, "/json", "", body);
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		check(std::string::npos != hdrs.find("\r\nVary: accept-encoding\r\n"));
+		check(std::string::npos != hdrs.find("\r\nEtag: \"v1\"\r\n"));
+		check(body == json);
+		hdrs = get(saddr, "/json", "Accept-Encoding: gzip;q=0, identity\r\n", body);
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		check(body == json);
+	}
+
+	// Responses not worth compressing are sent as is:
+	{
+		std::string hdrs = get(saddr, "/small", "Accept-Encoding: gzip\r\n", body);
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		check(std::string::npos != hdrs.find("\r\nContent-Length: 2\r\n"));
+		check(body == "{}");
+		hdrs = get(saddr, "/binary", "Accept-Encoding: gzip\r\n", body);
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		check(std::string::npos == hdrs.find("\r\nVary: "));
+		check(body == json);
+		hdrs = get(saddr, "/encoded", "Accept-Encoding: gzip\r\n", body);
+		check(std::string::npos != hdrs.find("\r\nContent-Encoding: identity\r\n"));
+		check(body == json);
+	}
+
+	// A flush before the minimum size commits to compressing.
+	{
+		std::string hdrs = get(saddr, "/flush", "Accept-Encoding: gzip\r\n", body);
+		check(std::string::npos != hdrs.find("\r\nContent-Encoding: gzip\r\n"));
+		check(body == "hello, world");
+	}
+
+	// A file served from memory, with the application's own content type, is
+	// sent whole and uncompressed.
+	for (int i = 0; i < 2; ++i) {
+		std::string hdrs = get(saddr, "/typed/b.txt", "Accept-Encoding: gzip\r\n", body);
+		check(0 == hdrs.find("HTTP/1.1 200 OK\r\n"));
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		check(std::string::npos != hdrs.find("\r\nContent-Length: " + std::to_string(text.size()) + "\r\n"));
+		check(body == text);
+	}
+
+	// A multipart/byteranges response is sent uncompressed, part headers and
+	// all.
+	{
+		std::string hdrs = get(saddr, "/files/a.txt", "Accept-Encoding: gzip\r\nRange: bytes=0-6,14-20\r\n", body);
+		check(0 == hdrs.find("HTTP/1.1 206 Partial content\r\n"));
+		check(std::string::npos == hdrs.find("\r\nContent-Encoding: "));
+		size_t const bpos = hdrs.find("boundary=");
+		check(std::string::npos != bpos);
+		std::string const boundary = hdrs.substr(bpos + 9, hdrs.find("\r\n", bpos) - bpos - 9);
+		auto mimep = mime::default_map.find(".txt");
+		std::string const type_line = mimep == mime::default_map.end() ? "" : "Content-Type: " + mimep->second + "\r\n";
+		check(body ==
+			"--" + boundary + "\r\n" +
+			type_line +
+			"Content-Range: bytes 0-6/" + std::to_string(text.size()) + "\r\n\r\n" +
+			text.substr(0, 7) + "\r\n"
+			"--" + boundary + "\r\n" +
+			type_line +
+			"Content-Range: bytes 14-20/" + std::to_string(text.size()) + "\r\n\r\n" +
+			text.substr(14, 7) + "\r\n"
+			"--" + boundary + "--\r\n");
+		check(std::string::npos != hdrs.find("\r\nContent-Length: " + std::to_string(body.size()) + "\r\n"));
+	}
+
+	// shutdown:
+	s.terminate();
+	thrd.join();
+	files.reset();
+	boost::filesystem::remove_all(root);
+}
+
@@ -0,0 +1,108 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_server.hpp"
+#include "../clane_net_inet.hpp"
+#include <atomic>
+#include <cstring>
+#include <unistd.h>
+
+using namespace clane;
+
+// The server's sockets use a TCP protocol family that counts send calls.
+static net::protocol_family counting_tcp4;
+static std::atomic<int> send_count;
+
+static net::socket counting_accept(net::socket_descriptor &sd, std::string *addr_o, std::error_code &e) {
+	net::socket sock = net::tcp4.accept(sd, addr_o, e);
+	if (e)
+		return sock;
+	return net::socket(&counting_tcp4, posix::unique_fd(::dup(sock.descriptor())));
+}
+
+static size_t counting_send(net::socket_descriptor &sd, void const *p, size_t n, int flags, std::error_code &e) {
+	++send_count;
+	return net::tcp4.send(sd, p, n, flags, e);
+}
+
+static size_t counting_sendv(net::socket_descriptor &sd, iovec const *iov, size_t cnt, int flags, std::error_code &e) {
+	++send_count;
+	return net::tcp4.sendv(sd, iov, cnt, flags, e);
+}
+
+void handle(http::response_ostream &rs, http::request &req) {
+	size_t n = req.uri.path == "/large" ? 10000 : 10;
+	rs << std::string(n, 'x');
+}
+
+// Receives one response, which is chunked unless it has a content length.
+static std::string recv_response(net::socket &cli) {
+	std::string resp;
+	while (true) {
+		size_t hdrs_end = resp.find("\r\n\r\n");
+		if (std::string::npos != hdrs_end) {
+			size_t len_pos = resp.find("Content-Length: ");
+			if (std::string::npos != len_pos && len_pos < hdrs_end) {
+				if (resp.size() == hdrs_end + 4 + std::stoul(resp.substr(len_pos + 16)))
+					break;
+			} else if (resp.size() >= 5 && !resp.compare(resp.size()-5, 5, "0\r\n\r\n")) {
+				break;
+			}
+		}
+		char buf[4096];
+		std::error_code e;
+		size_t xstat = cli.recv(buf, sizeof(buf), e);
+		check(!e);
+		check(xstat);
+		resp += std::string(buf, xstat);
+	}
+	return resp;
+}
+
+int main() {
+
+	counting_tcp4 = net::tcp4;
+	counting_tcp4.accept = counting_accept;
+	counting_tcp4.send = counting_send;
+	counting_tcp4.sendv = counting_sendv;
+
+	// run server:
+	http::server s;
+	s.root_handler = handle;
+	auto lis4 = net::listen(&net::tcp4, "127.0.0.1:");
+	std::string saddr = lis4.local_address();
+	s.add_listener(net::socket(&counting_tcp4, posix::unique_fd(::dup(lis4.descriptor()))));
+	lis4 = net::socket();
+	std::thread thrd(&http::server::serve, &s);
+
+	std::error_code e;
+	auto cli = net::connect(&net::tcp4, saddr, e);
+	check(!e);
+
+	// A small response--headers and the whole body--goes out in one send.
+	{
+		static char const *R = "GET /small HTTP/1.1\r\n\r\n";
+		cli.send(R, std::strlen(R), net::all, e);
+		check(!e);
+		std::string resp = recv_response(cli);
+		check(std::string::npos != resp.find("Content-Length: 10\r\n\r\nxxxxxxxxxx"));
+		check(1 == send_count);
+	}
+
+	// A large response goes out in one send per full output buffer plus one for
+	// the remainder.
+	{
+		send_count = 0;
+		static char const *R = "GET /large HTTP/1.1\r\n\r\n";
+		cli.send(R, std::strlen(R), net::all, e);
+		check(!e);
+		recv_response(cli);
+		check(3 == send_count);
+	}
+
+	// shutdown:
+	cli.fin();
+	s.terminate();
+	thrd.join();
+}
+
@@ -0,0 +1,60 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_server.hpp"
+#include "../clane_net_inet.hpp"
+#include <cstring>
+
+using namespace clane;
+
+void handle(http::response_ostream &rs, http::request &req) {
+	rs << "Hello, from Clane!\n";
+}
+
+int main() {
+
+	// Reserve an address for the server. The server's listeners may bind to the
+	// address alongside this socket because all of them use SO_REUSEPORT.
+	auto probe = net::listen(&net::tcp, "localhost:", -1, net::reuse_port);
+	std::string saddr = probe.local_address();
+
+	// run server:
+	http::server s;
+	s.root_handler = handle;
+	s.loop_count = 3;
+	s.shard_listeners = true;
+	s.pin_loops = true;
+	s.add_listener(saddr);
+	probe = net::socket();
+	std::thread thrd(&http::server::serve, &s);
+
+	// Each connection goes to one of the server's shards.
+	for (int i = 0; i < 9; ++i) {
+
+		std::error_code e;
+		auto cli = net::connect(&net::tcp4, saddr, e);
+		check(!e);
+		static char const *R =
+			"GET / HTTP/1.1\r\n"
+			"\r\n";
+		cli.send(R, std::strlen(R), net::all, e);
+		check(!e);
+		cli.fin();
+
+		std::string resp;
+		while (true) {
+			char buf[100];
+			size_t xstat = cli.recv(buf, sizeof(buf), e);
+			check(!e);
+			if (!xstat)
+				break;
+			resp += std::string(buf, xstat);
+		}
+		check(0 == resp.find("HTTP/1.1 200 OK\r\n"));
+	}
+
+	// shutdown:
+	s.terminate();
+	thrd.join();
+}
+
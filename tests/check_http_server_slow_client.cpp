@@ -0,0 +1,76 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_http_server.hpp"
+#include "../clane_net_inet.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace clane;
+
+// Each response is much larger than the socket buffers, so the server must
+// queue output and wait for the client to catch up.
+static size_t const body_size = 4 * 1024 * 1024;
+
+void handle(http::response_ostream &rs, http::request &req) {
+	char c = req.uri.path == "/a" ? 'a' : 'b';
+	rs.headers.insert(http::header("content-length", std::to_string(body_size)));
+	std::string chunk(1000, c);
+	for (size_t n = 0; n < body_size; n += chunk.size())
+		rs.write(chunk.data(), std::min(chunk.size(), body_size - n));
+}
+
+int main() {
+
+	// run server:
+	http::server s;
+	s.root_handler = handle;
+	s.loop_count = 1;
+	auto lis = net::listen(&net::tcp, "localhost:");
+	std::string saddr = lis.local_address();
+	s.add_listener(std::move(lis));
+	std::thread thrd(&http::server::serve, &s);
+
+	// send two pipelined requests:
+	std::error_code e;
+	auto cli = net::connect(&net::tcp4, saddr, e);
+	check(!e);
+	static char const *R =
+		"GET /a HTTP/1.1\r\n"
+		"\r\n"
+		"GET /b HTTP/1.1\r\n"
+		"\r\n";
+	cli.send(R, std::strlen(R), net::all, e);
+	check(!e);
+	cli.fin();
+
+	// let the server fill the socket buffers before reading:
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	std::string resp;
+	while (true) {
+		char buf[65536];
+		size_t xstat = cli.recv(buf, sizeof(buf), e);
+		check(!e);
+		if (!xstat)
+			break;
+		resp += std::string(buf, xstat);
+	}
+
+	// Both responses arrive complete and in order, without interleaving.
+	size_t a_beg = resp.find("\r\n\r\n");
+	check(std::string::npos != a_beg);
+	a_beg += 4;
+	check(resp.size() > a_beg + body_size);
+	check(std::string(body_size, 'a') == resp.substr(a_beg, body_size));
+	size_t b_beg = resp.find("\r\n\r\n", a_beg + body_size);
+	check(std::string::npos != b_beg);
+	b_beg += 4;
+	check(resp.size() == b_beg + body_size);
+	check(std::string(body_size, 'b') == resp.substr(b_beg));
+
+	// shutdown:
+	s.terminate();
+	thrd.join();
+}
+
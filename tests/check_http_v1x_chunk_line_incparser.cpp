@@ -73,10 +73,16 @@ int main() {
 	check_ok("abc\r\n", 0xabc);
 	check_ok("abc\n", 0xabc);
 	check_ok("1bC\r\n", 0x1bc);
+	check_ok("000000000000000000000000123\r\n", 0x123);
+	check_ok((std::string(2 * sizeof(size_t), 'f') + "\r\n").c_str(), static_cast<size_t>(-1));
 
 	check_nok(0, "", "\r\n", http::status_code::bad_request);
 	check_nok(0, "12", "invalid34\r\n", http::status_code::bad_request);
 	check_nok(0, "1234", " \r\n", http::status_code::bad_request);
 	check_nok(0, "12", " 34\r\n", http::status_code::bad_request);
+
+	// overflow:
+	check_nok(0, std::string(2 * sizeof(size_t), 'f').c_str(), "0\r\n", http::status_code::bad_request);
+	check_nok(0, ("1" + std::string(2 * sizeof(size_t) - 1, '0')).c_str(), "0\r\n", http::status_code::bad_request);
 }
 
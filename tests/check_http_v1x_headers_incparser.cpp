@@ -3,6 +3,7 @@
 #include "clane_check.hpp"
 #include "../clane_http_parse.hpp"
 #include <cstring>
+#include <memory>
 
 using namespace clane;
 
@@ -35,6 +36,47 @@ void check_ok(char const *content, http::header_map const &exp_hdrs, size_t len_
 	check(pars.headers() == exp_hdrs);
 }
 
+http::header_map views_to_map(std::vector<http::header_view> const &views) {
+	http::header_map hdrs;
+	for (auto i = views.begin(); i != views.end(); ++i)
+		hdrs.insert(http::header(i->name_str(), i->value_str()));
+	return hdrs;
+}
+
+bool refers_to(char const *p, std::string const &s) {
+	return s.data() <= p && p < s.data() + s.size();
+}
+
+void check_ok_views(char const *content, http::header_map const &exp_hdrs, bool exp_in_place) {
+
+	std::string const s = std::string(content) + "extra";
+	http::v1x_headers_incparser pars;
+	pars.set_view_mode(true);
+
+	// single pass:
+	pars.reset();
+	check(std::strlen(content) == pars.parse_some(s.data(), s.data()+s.size()));
+	check(!pars);
+	check(pars.headers().empty());
+	check(views_to_map(pars.header_views()) == exp_hdrs);
+	auto const &views = pars.header_views();
+	for (auto i = views.begin(); i != views.end(); ++i) {
+		check(refers_to(i->name, s));
+		check(exp_in_place == refers_to(i->value, s));
+	}
+
+	// byte-by-byte: every header spans blocks, so nothing refers to the input
+	pars.reset();
+	for (size_t i = 0; i < std::strlen(content); ++i)
+		check(1 == pars.parse_some(s.data()+i, s.data()+i+1));
+	check(!pars);
+	check(views_to_map(pars.header_views()) == exp_hdrs);
+	for (auto i = views.begin(); i != views.end(); ++i) {
+		check(!refers_to(i->name, s));
+		check(!refers_to(i->value, s));
+	}
+}
+
 void check_nok(size_t len_limit, char const *ok, char const *bad, http::status_code exp_error_code) {
 
 	static char const *const empty = "";
@@ -91,12 +133,68 @@ int main() {
 	check_ok("alpha: bravo\t\t\t\r\n\r\n", http::header_map({http::header("alpha", "bravo")}));
 	check_ok("alpha: bravo \t \r\n\r\n", http::header_map({http::header("alpha", "bravo")}));
 
+	// empty value:
+	check_ok("alpha:\r\n\r\n", http::header_map({http::header("alpha", "")}));
+	check_ok("alpha: \t \r\nbravo: charlie\r\n\r\n", http::header_map({
+		http::header("alpha", ""),
+		http::header("bravo", "charlie")}));
+
 	// linear whitespace:
 	check_ok("alpha: bravo\r\n charlie delta\r\n\r\n", http::header_map({
 		http::header("alpha", "bravo charlie delta")}));
 	check_ok("alpha: bravo\r\n\tcharlie delta\r\n\r\n", http::header_map({
 		http::header("alpha", "bravo charlie delta")}));
 
+	// view mode:
+	check_ok_views("\r\n", http::header_map({}), true);
+	check_ok_views("alpha: bravo\r\ncharlie  : delta \t\r\n\r\n", http::header_map({
+		http::header("alpha", "bravo"),
+		http::header("charlie", "delta")}), true);
+	check_ok_views("alpha: bravo\ncharlie: delta\n\n", http::header_map({
+		http::header("alpha", "bravo"),
+		http::header("charlie", "delta")}), true);
+	check_ok_views("alpha: bravo\r\n charlie delta\r\n\r\n", http::header_map({
+		http::header("alpha", "bravo charlie delta")}), false);
+	check_ok_views("alpha: bravo \r\n\tcharlie\r\n\t delta\r\n\r\n", http::header_map({
+		http::header("alpha", "bravo  charlie delta")}), false);
+
+	// view mode, split between two blocks:
+	{
+		std::string const s("alpha: bravo\r\ncharlie: delta\r\necho: foxtrot\r\n\r\n");
+		size_t const split = s.find("delta") + 2;
+		http::v1x_headers_incparser pars;
+		pars.set_view_mode(true);
+		pars.reset();
+		check(split == pars.parse_some(s.data(), s.data()+split));
+		check(s.size()-split == pars.parse_some(s.data()+split, s.data()+s.size()));
+		check(!pars);
+		auto const &views = pars.header_views();
+		check(3 == views.size());
+		check(views_to_map(views) == http::header_map({
+			http::header("alpha", "bravo"),
+			http::header("charlie", "delta"),
+			http::header("echo", "foxtrot")}));
+		check(refers_to(views[0].value, s));
+		check(refers_to(views[1].name, s));
+		check(!refers_to(views[1].value, s));
+		check(refers_to(views[2].name, s));
+		check(refers_to(views[2].value, s));
+
+		// A copy's views refer to its own copies, not to the original's.
+		std::unique_ptr<http::v1x_headers_incparser> orig(new http::v1x_headers_incparser(pars));
+		http::v1x_headers_incparser copy(*orig);
+		http::v1x_headers_incparser assigned;
+		assigned = *orig;
+		check(orig->header_views()[1].value != copy.header_views()[1].value);
+		check(orig->header_views()[1].value != assigned.header_views()[1].value);
+		orig.reset();
+		check(views_to_map(copy.header_views()) == views_to_map(views));
+		check(views_to_map(assigned.header_views()) == views_to_map(views));
+		check(refers_to(copy.header_views()[2].value, s));
+		http::v1x_headers_incparser moved(std::move(copy));
+		check(views_to_map(moved.header_views()) == views_to_map(views));
+	}
+
 	// not-OK: missing colon between name and value
 	check_nok(0, "alpha bravo", "\r\n\r\n", http::status_code::bad_request);
 	check_nok(0, "alpha bravo", "\r\ncharlie: delta\r\n", http::status_code::bad_request);
@@ -123,6 +123,39 @@ int main() {
 		 	"GET", "/", 1, 1, http::header_map{http::header("content-length", "13")},
 		 	"Hello, world.", http::header_map{});
 
+	// unusual heads, which the one-pass parser leaves to the incremental parsers:
+	check_ok("GET / HTTP/1.1\r\nAlpha: bravo\r\n charlie\r\nDelta: echo\r\n\r\n",
+			"GET", "/", 1, 1, http::header_map{
+				http::header("alpha", "bravo charlie"),
+				http::header("delta", "echo")},
+			"", http::header_map{});
+	check_ok("GET /alpha?bravo HTTP/12.34\nAlpha:   \nBravo:charlie\n\n",
+			"GET", "/alpha?bravo", 12, 34, http::header_map{
+				http::header("alpha", ""),
+				http::header("bravo", "charlie")},
+			"", http::header_map{});
+	check_ok("POST /alpha HTTP/1.0\r\nContent-Length: 5\r\nAlpha: bravo\r\n\r\nhello",
+			"POST", "/alpha", 1, 0, http::header_map{
+				http::header("content-length", "5"),
+				http::header("alpha", "bravo")},
+			"hello", http::header_map{});
+
+	// length limit applies to a head parsed in one pass:
+	{
+		std::string const s("GET /alpha/bravo/charlie HTTP/1.1\r\nAlpha: bravo\r\n\r\n");
+		http::v1x_request_incparser pars;
+		pars.reset();
+		pars.set_length_limit(34);
+		check(pars.error == pars.parse_some(s.data(), s.data()+s.size()));
+		check(http::status_code::request_uri_too_long == pars.status());
+		pars.reset();
+		pars.set_length_limit(35);
+		check(s.size() == pars.parse_some(s.data(), s.data()+s.size()));
+		check(!pars);
+		check(pars.got_headers());
+		check(pars.uri().string() == "/alpha/bravo/charlie");
+	}
+
 	// error: bad request line
 	check_nok("GET / ", "\r\nContent-Length: 13\r\n\r\nHello, world.", http::status_code::bad_request);
 
@@ -6,7 +6,8 @@
 
 using namespace clane;
 
-void check_ok(char const *content, char const *exp_method, char const *exp_uri, int exp_major, int exp_minor) {
+void check_ok(char const *content, char const *exp_method, char const *exp_uri, int exp_major, int exp_minor,
+	http::method_set exp_method_id = http::method_get) {
 
 	static char const *const empty = "";
 	std::string const s = std::string(content) + "extra";
@@ -18,6 +19,7 @@ void check_ok(char const *content, char const *exp_method, char const *exp_uri,
 	check(std::strlen(content) == pars.parse_some(s.data(), s.data()+s.size()));
 	check(!pars);
 	check(pars.method() == exp_method);
+	check(pars.method_id() == exp_method_id);
 	check(pars.uri().string() == exp_uri);
 	check(pars.major_version() == exp_major);
 	check(pars.minor_version() == exp_minor);
@@ -36,6 +38,7 @@ void check_ok(char const *content, char const *exp_method, char const *exp_uri,
 	check(1 == pars.parse_some(s.data()+std::strlen(content)-1, s.data()+std::strlen(content)));
 	check(!pars);
 	check(pars.method() == exp_method);
+	check(pars.method_id() == exp_method_id);
 	check(pars.uri().string() == exp_uri);
 	check(pars.major_version() == exp_major);
 	check(pars.minor_version() == exp_minor);
@@ -77,6 +80,9 @@ int main() {
 	check_ok("GET / HTTP/1.1\r\n", "GET", "/", 1, 1);
 	check_ok("GET /foo?bar HTTP/1.1\r\n", "GET", "/foo?bar", 1, 1);
 	check_ok("GET /foo?bar HTTP/1.0\r\n", "GET", "/foo?bar", 1, 0);
+	check_ok("DELETE /foo HTTP/1.1\r\n", "DELETE", "/foo", 1, 1, http::method_delete);
+	check_ok("PURGE /foo HTTP/1.1\r\n", "PURGE", "/foo", 1, 1, http::method_other);
+	check_ok("get /foo HTTP/1.1\r\n", "get", "/foo", 1, 1, http::method_other);
 
 	// not-OK: empty line
 	check_nok(0, "", "\r\n", http::status_code::bad_request);
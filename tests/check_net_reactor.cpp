@@ -0,0 +1,64 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_net_event.hpp"
+#include "../clane_net_inet.hpp"
+#include "../clane_net_poller.hpp"
+#include "../clane_net_socket.hpp"
+#include <thread>
+
+using namespace clane;
+
+int main() {
+
+	net::reactor reactor;
+	net::reactor_event evs[4];
+
+	// event:
+	{
+		net::event ev;
+		reactor.add(ev, reactor.in, &ev);
+		check(0 == reactor.wait(evs, 4, std::chrono::steady_clock::now()));
+		std::thread thrd(&net::event::signal, &ev);
+		size_t n = reactor.wait(evs, 4);
+		thrd.join();
+		check(1 == n);
+		check(evs[0].data == &ev);
+		check(evs[0].events == reactor.in);
+
+		// edge-triggered: no new notification until the state changes
+		check(0 == reactor.wait(evs, 4, std::chrono::steady_clock::duration::zero()));
+		ev.signal();
+		check(1 == reactor.wait(evs, 4, std::chrono::steady_clock::duration::zero()));
+		reactor.remove(ev);
+	}
+
+	// sockets:
+	{
+		std::error_code e;
+		auto lis = net::listen(&net::tcp, "localhost:");
+		lis.set_nonblocking();
+		reactor.add(lis, reactor.in, &lis);
+		auto cli = net::connect(&net::tcp, lis.local_address(), e);
+		check(!e);
+		check(1 == reactor.wait(evs, 4));
+		check(evs[0].data == &lis);
+		auto ser = lis.accept(e);
+		check(!e);
+		ser.set_nonblocking();
+		reactor.add(ser, reactor.in | reactor.out, &ser);
+		check(1 == reactor.wait(evs, 4));
+		check(evs[0].data == &ser);
+		check(evs[0].events == reactor.out);
+		cli.send("x", 1, e);
+		check(!e);
+		check(1 == reactor.wait(evs, 4));
+		check(evs[0].data == &ser);
+		check(evs[0].events & reactor.in);
+		reactor.modify(ser, reactor.in, &cli);
+		cli.fin();
+		check(1 == reactor.wait(evs, 4));
+		check(evs[0].data == &cli);
+	}
+}
+
@@ -0,0 +1,33 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_net_inet.hpp"
+#include "../clane_net_socket.hpp"
+
+using namespace clane;
+
+int main() {
+
+	// without reuse_port, a second listener can't bind to the same address:
+	{
+		auto lis1 = net::listen(&net::tcp, "localhost:");
+		bool thrown{};
+		try {
+			auto lis2 = net::listen(&net::tcp, lis1.local_address());
+		} catch (std::system_error &) {
+			thrown = true;
+		}
+		check(thrown);
+	}
+
+	// with reuse_port, listeners share the address and both accept:
+	{
+		auto lis1 = net::listen(&net::tcp, "localhost:", -1, net::reuse_port);
+		auto lis2 = net::listen(&net::tcp, lis1.local_address(), -1, net::reuse_port);
+		check(lis1.local_address() == lis2.local_address());
+		std::error_code e;
+		auto cli = net::connect(&net::tcp, lis1.local_address(), e);
+		check(!e);
+	}
+}
+
@@ -0,0 +1,70 @@
+// vim: set noet:
+
+#include "clane_check.hpp"
+#include "../clane_sync_thread_pool.hpp"
+#include <atomic>
+
+using namespace clane;
+
+int main() {
+
+	// all queued tasks run before destruction:
+	{
+		std::atomic<int> n(0);
+		{
+			sync::thread_pool pool(4);
+			check(4 == pool.size());
+			for (int i = 0; i < 100; ++i)
+				check(pool.submit([&n]() { ++n; }));
+		}
+		check(100 == n);
+	}
+
+	// bounded queue:
+	{
+		std::mutex mutex;
+		std::condition_variable cond;
+		bool started{}, released{};
+		sync::thread_pool pool(1, 1);
+		check(pool.submit([&]() {
+			std::unique_lock<std::mutex> lock(mutex);
+			started = true;
+			cond.notify_all();
+			while (!released)
+				cond.wait(lock);
+		}));
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!started)
+				cond.wait(lock);
+		}
+		check(pool.submit([]() {})); // fills the queue
+		check(!pool.submit([]() {}));
+		auto stats = pool.stats();
+		check(1 == stats.started);
+		check(1 == stats.rejected);
+		check(1 == stats.queued);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			released = true;
+			cond.notify_all();
+		}
+	}
+
+	// stack size:
+	{
+		size_t const want = 1024 * 1024;
+		size_t got{};
+		{
+			sync::thread_pool pool(1, 0, want);
+			pool.submit([&got]() {
+				pthread_attr_t attr;
+				pthread_getattr_np(pthread_self(), &attr);
+				pthread_attr_getstacksize(&attr, &got);
+				pthread_attr_destroy(&attr);
+			});
+		}
+		check(got >= want);
+	}
+}
+